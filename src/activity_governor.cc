@@ -0,0 +1,120 @@
+#include "activity_governor.h"
+
+#include <cstdlib>
+
+#include "configuration.h"
+#include "frame_processor.h"
+
+using namespace cv;
+using namespace std;
+
+// Points sampled across and down the frame.
+static const int THUMBNAIL_COLS = 64;
+static const int THUMBNAIL_ROWS = 48;
+// Weight of the newest frame in the average processing time.
+static const double AVERAGE_WEIGHT = 0.1;
+
+ActivityGovernor::ActivityGovernor()
+    : mode_(GovernorActive)
+    , lastActivity_(Clock::now())
+    , averageMs_(0)
+    , skipped_(0)
+    , savedMs_(0)
+{
+}
+
+bool ActivityGovernor::ShouldProcess(const Mat& frame,
+                                     const Clock::time_point now)
+{
+  Configuration& config = Configuration::Instance();
+  if (!config.ReadBool("governor_enabled")) {
+    mode_ = GovernorActive;
+    return true;
+  }
+
+  if (!Thumbnail(frame, &thumbnail_) || Differs(thumbnail_)) {
+    lastActivity_ = now;
+  }
+
+  const double idleAfterS = config.ReadDouble("governor_idle_after_s");
+  mode_ = now - lastActivity_ >
+      chrono::duration_cast<Clock::duration>(
+          chrono::duration<double>(idleAfterS))
+      ? GovernorIdle : GovernorActive;
+
+  const double idleFps = config.ReadDouble("governor_idle_fps");
+  if (mode_ == GovernorIdle && idleFps > 0 &&
+      now - lastProcessed_ < chrono::duration_cast<Clock::duration>(
+          chrono::duration<double>(1.0 / idleFps))) {
+    ++skipped_;
+    savedMs_ += averageMs_;
+    return false;
+  }
+
+  lastProcessed_ = now;
+  reference_.swap(thumbnail_);
+  return true;
+}
+
+void ActivityGovernor::OnProcessed(const vector<GlyphEvent>& events,
+                                   const double processingMs,
+                                   const Clock::time_point now)
+{
+  averageMs_ = averageMs_ == 0
+      ? processingMs
+      : averageMs_ + AVERAGE_WEIGHT * (processingMs - averageMs_);
+
+  // Glyphs moving, turning, coming or going.
+  if (!events.empty()) {
+    lastActivity_ = now;
+    mode_ = GovernorActive;
+  }
+}
+
+bool ActivityGovernor::Thumbnail(const Mat& frame, vector<uint8_t>* thumbnail)
+{
+  // Encoded frames are decoded at 1/8 of their size, which libjpeg does
+  // from the DC coefficients alone.
+  Mat image = frame;
+  if (FrameProcessor::IsEncoded(frame)) {
+    if (!jpegDecoder_.Decode(frame.ptr<uint8_t>(), frame.total(), 8,
+                             &decoded_)) {
+      return false;
+    }
+    image = decoded_;
+  }
+
+  thumbnail->resize(THUMBNAIL_COLS * THUMBNAIL_ROWS);
+  const int channels = image.channels();
+  uint8_t* out = &(*thumbnail)[0];
+  for (int i = 0; i < THUMBNAIL_ROWS; ++i) {
+    const uint8_t* row =
+        image.ptr<uint8_t>((2 * i + 1) * image.rows / (2 * THUMBNAIL_ROWS));
+    for (int j = 0; j < THUMBNAIL_COLS; ++j) {
+      const int x = (2 * j + 1) * image.cols / (2 * THUMBNAIL_COLS);
+      const uint8_t* pixel = row + x * channels;
+      // Rough luma for BGR, the Y byte of YUYV.
+      *out++ = channels == 3 ? (pixel[0] + 2 * pixel[1] + pixel[2]) >> 2
+                             : pixel[0];
+    }
+  }
+
+  return true;
+}
+
+bool ActivityGovernor::Differs(const vector<uint8_t>& thumbnail) const
+{
+  if (thumbnail.size() != reference_.size()) {
+    return true;
+  }
+
+  Configuration& config = Configuration::Instance();
+  const int pixelThreshold = config.ReadInt("governor_pixel_threshold");
+  const int minChanged = config.ReadInt("governor_min_changed_pixels");
+  int changed = 0;
+  for (size_t i = 0; i < thumbnail.size(); ++i) {
+    changed += abs(thumbnail[i] - reference_[i]) > pixelThreshold;
+  }
+
+  return changed >= minChanged;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "glyph_tracker.h"
+#include "jpeg_decoder.h"
+
+enum GovernorMode
+{
+  GovernorActive = 0,
+  GovernorIdle
+};
+
+// Lowers the detection rate while nothing happens on the table. Every
+// captured frame is compared, by a small thumbnail of point samples,
+// against the last processed one; that and the track events of processed
+// frames are the activity. After governor_idle_after_s without any, frames
+// are only processed at governor_idle_fps, until a frame differs again,
+// which is then processed right away.
+class ActivityGovernor
+{
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  ActivityGovernor();
+
+  // Decides about a captured frame, BGR, YUYV, gray or encoded, before any
+  // work is done on it.
+  bool ShouldProcess(const cv::Mat& frame, const Clock::time_point now);
+  // Reports what processing a frame took and the track events it gave.
+  void OnProcessed(const std::vector<GlyphEvent>& events,
+                   const double processingMs, const Clock::time_point now);
+
+  GovernorMode Mode() const { return mode_; }
+  long Skipped() const { return skipped_; }
+  // Processing time of the skipped frames, estimated from the recent
+  // processed ones.
+  double SavedMs() const { return savedMs_; }
+
+ private:
+  // Luma at a grid of points spread over the frame. Returns false for
+  // encoded frames that can't be decoded.
+  bool Thumbnail(const cv::Mat& frame, std::vector<uint8_t>* thumbnail);
+  bool Differs(const std::vector<uint8_t>& thumbnail) const;
+
+  GovernorMode mode_;
+  Clock::time_point lastActivity_;
+  Clock::time_point lastProcessed_;
+  // Of the last processed frame.
+  std::vector<uint8_t> reference_;
+  std::vector<uint8_t> thumbnail_;
+  JpegDecoder jpegDecoder_;
+  cv::Mat decoded_;
+  double averageMs_;
+  long skipped_;
+  double savedMs_;
+};
@@ -0,0 +1,167 @@
+#include "bitmap.h"
+
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+Bitmap::Bitmap()
+    : rows_(0)
+    , cols_(0)
+    , words_(0)
+{
+}
+
+Bitmap::Bitmap(const int rows, const int cols)
+{
+  Reset(rows, cols);
+}
+
+void Bitmap::Reset(const int rows, const int cols)
+{
+  rows_ = rows;
+  cols_ = cols;
+  words_ = (cols + 63) / 64;
+  bits_.assign(size_t(rows) * words_, 0);
+}
+
+int Bitmap::Count(const int y, const int x0, const int x1) const
+{
+  const uint64_t* row = Row(y);
+  int count = 0;
+  for (int x = x0; x < x1; ) {
+    const int bit = x & 63;
+    const int n = min(64 - bit, x1 - x);
+    const uint64_t mask = (n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1)
+                          << bit;
+    count += __builtin_popcountll(row[x >> 6] & mask);
+    x += n;
+  }
+
+  return count;
+}
+
+// Clear pixels of a word, leaving out the bits past the last column.
+static uint64_t ClearPixels(const uint64_t word, const uint64_t columns)
+{
+  return ~word & columns;
+}
+
+bool Bitmap::GrowAlongRow(const int y, uint64_t* exterior) const
+{
+  const uint64_t* row = Row(y);
+  const uint64_t lastColumns =
+      cols_ % 64 ? (uint64_t(1) << (cols_ % 64)) - 1 : ~uint64_t(0);
+  bool changed = false;
+
+  // Kogge-Stone fills: each step doubles the distance the exterior has
+  // grown through runs of clear pixels. Towards higher columns first,
+  // carrying bit 63 into the next word.
+  uint64_t carry = 0;
+  for (int w = 0; w < words_; ++w) {
+    uint64_t open =
+        ClearPixels(row[w], w == words_ - 1 ? lastColumns : ~uint64_t(0));
+    uint64_t grown = exterior[w] | (carry & open);
+    for (int shift = 1; shift < 64; shift *= 2) {
+      grown |= open & (grown << shift);
+      open &= open << shift;
+    }
+    carry = grown >> 63;
+    changed |= grown != exterior[w];
+    exterior[w] = grown;
+  }
+
+  carry = 0;
+  for (int w = words_ - 1; w >= 0; --w) {
+    uint64_t open =
+        ClearPixels(row[w], w == words_ - 1 ? lastColumns : ~uint64_t(0));
+    uint64_t grown = exterior[w] | ((carry << 63) & open);
+    for (int shift = 1; shift < 64; shift *= 2) {
+      grown |= open & (grown >> shift);
+      open &= open >> shift;
+    }
+    carry = grown & 1;
+    changed |= grown != exterior[w];
+    exterior[w] = grown;
+  }
+
+  return changed;
+}
+
+void Bitmap::FillHoles()
+{
+  if (rows_ == 0 || cols_ == 0) {
+    return;
+  }
+
+  const uint64_t lastColumns =
+      cols_ % 64 ? (uint64_t(1) << (cols_ % 64)) - 1 : ~uint64_t(0);
+  const uint64_t firstPixel = 1;
+  const uint64_t lastPixel = uint64_t(1) << ((cols_ - 1) % 64);
+
+  // Seeded with the clear pixels on the edges.
+  exterior_.assign(bits_.size(), 0);
+  for (int y = 0; y < rows_; ++y) {
+    const uint64_t* row = Row(y);
+    uint64_t* exterior = &exterior_[y * words_];
+    if (y == 0 || y == rows_ - 1) {
+      for (int w = 0; w < words_; ++w) {
+        exterior[w] =
+            ClearPixels(row[w], w == words_ - 1 ? lastColumns : ~uint64_t(0));
+      }
+    } else {
+      exterior[0] |= ~row[0] & firstPixel;
+      exterior[words_ - 1] |= ~row[words_ - 1] & lastPixel;
+    }
+  }
+
+  // Sweeps down and up, growing into each row from its neighbour and then
+  // along it. Most blobs converge in one or two rounds.
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (int y = 0; y < rows_; ++y) {
+      changed |= GrowRow(y, y - 1);
+    }
+    for (int y = rows_ - 1; y >= 0; --y) {
+      changed |= GrowRow(y, y + 1);
+    }
+  }
+
+  for (int y = 0; y < rows_; ++y) {
+    uint64_t* row = Row(y);
+    const uint64_t* exterior = &exterior_[y * words_];
+    for (int w = 0; w < words_; ++w) {
+      row[w] = ~exterior[w] & (w == words_ - 1 ? lastColumns : ~uint64_t(0));
+    }
+  }
+}
+
+bool Bitmap::GrowRow(const int y, const int from)
+{
+  uint64_t* exterior = &exterior_[y * words_];
+  bool changed = false;
+  if (from >= 0 && from < rows_) {
+    const uint64_t* row = Row(y);
+    const uint64_t* neighbour = &exterior_[from * words_];
+    for (int w = 0; w < words_; ++w) {
+      const uint64_t grown = exterior[w] | (neighbour[w] & ~row[w]);
+      changed |= grown != exterior[w];
+      exterior[w] = grown;
+    }
+  }
+
+  return GrowAlongRow(y, exterior) || changed;
+}
+
+void Bitmap::Unpack(Mat image, const uchar value) const
+{
+  for (int y = 0; y < rows_; ++y) {
+    const uint64_t* row = Row(y);
+    uchar* out = image.ptr<uchar>(y);
+    for (int w = 0; w < words_; ++w) {
+      for (uint64_t bits = row[w]; bits; bits &= bits - 1) {
+        out[w * 64 + __builtin_ctzll(bits)] = value;
+      }
+    }
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+// Binary image packed 64 pixels to a word, pixel x of a row being bit x % 64
+// of word x / 64. Bits past the last column are always clear.
+class Bitmap
+{
+ public:
+  Bitmap();
+  Bitmap(const int rows, const int cols);
+
+  // Clears every pixel; keeps the capacity when the size doesn't grow.
+  void Reset(const int rows, const int cols);
+
+  int Rows() const { return rows_; }
+  int Cols() const { return cols_; }
+  int Words() const { return words_; }
+  uint64_t* Row(const int y) { return &bits_[y * words_]; }
+  const uint64_t* Row(const int y) const { return &bits_[y * words_]; }
+
+  bool Get(const int y, const int x) const
+  {
+    return (Row(y)[x >> 6] >> (x & 63)) & 1;
+  }
+  void Set(const int y, const int x)
+  {
+    Row(y)[x >> 6] |= uint64_t(1) << (x & 63);
+  }
+  // Number of set pixels of row y from x0 up to, not including, x1.
+  int Count(const int y, const int x0, const int x1) const;
+
+  // Sets the pixels not connected to the edge of the bitmap through clear
+  // pixels, i.e. the holes of the set regions. The exterior is grown
+  // a whole word at a time, along rows and between rows, until it stops
+  // changing.
+  void FillHoles();
+
+  // Writes value to the pixels of image that are set in the bitmap; the
+  // others are left alone. image is 8-bit and of the same size.
+  void Unpack(cv::Mat image, const uchar value) const;
+
+ private:
+  // Grows the exterior of row y from row from, if there is one, and then
+  // along the row, within the clear pixels. Return whether it changed.
+  bool GrowRow(const int y, const int from);
+  bool GrowAlongRow(const int y, uint64_t* exterior) const;
+
+  int rows_;
+  int cols_;
+  int words_;
+  std::vector<uint64_t> bits_;
+  // Scratch for FillHoles.
+  std::vector<uint64_t> exterior_;
+};
@@ -4,14 +4,66 @@
 #include <cassert>
 #include <limits>
 #include <queue>
-#include <sstream>
 
 using namespace cv;
 using namespace std;
 
 typedef unsigned char uchar;
 
+size_t BlobTable::Size() const
+{
+  return label.size();
+}
+
+void BlobTable::Clear()
+{
+  bbox.clear();
+  numPixels.clear();
+  origin.clear();
+  label.clear();
+  vertexBegin.clear();
+  vertexCount.clear();
+  vertices.clear();
+}
+
+void BlobTable::Add(const Rect& bbox, const int numPixels,
+                    const Point2f& origin, const short label)
+{
+  this->bbox.push_back(bbox);
+  this->numPixels.push_back(numPixels);
+  this->origin.push_back(origin);
+  this->label.push_back(label);
+  vertexBegin.push_back(0);
+  vertexCount.push_back(0);
+}
+
+int BlobShape::Holes() const
+{
+  return 1 - (numPixels - edges + squares);
+}
+
+int BlobShape::OctagonArea() const
+{
+  const int x0 = bbox.x;
+  const int y0 = bbox.y;
+  const int x1 = bbox.x + bbox.width - 1;
+  const int y1 = bbox.y + bbox.height - 1;
+
+  // Each diagonal cuts a right isosceles triangle off a corner of the bbox.
+  const int topLeft = minSum - (x0 + y0);
+  const int topRight = (x1 - y0) - maxDiff;
+  const int bottomRight = (x1 + y1) - maxSum;
+  const int bottomLeft = minDiff - (x0 - y1);
+
+  return bbox.area() -
+         (topLeft * topLeft + topRight * topRight +
+          bottomRight * bottomRight + bottomLeft * bottomLeft) / 2;
+}
+
 BlobDetector::BlobDetector()
+    : prefilter_()
+    , rightAngleParams_()
+    , rightAngleResponse_(0.0f)
 {
 }
 
@@ -21,51 +73,30 @@ BlobDetector::~BlobDetector()
 
 void BlobDetector::Run(const Mat grayscale)
 {
-  blobs_.clear();
-  candidates_.clear();
+  Run(grayscale, grayscale.cols);
+}
 
-  Mat canny = DetectGradient(grayscale);
+void BlobDetector::Run(const Mat grayscale, const int frameWidth)
+{
+  blobs_.Clear();
+  candidates_.clear();
 
-  // Padded frame with labels of connected components.
-  labeled_ = Mat(grayscale.rows + 2, grayscale.cols + 2, CV_16SC1);
-  labeled_.setTo(Scalar(-2));
-
-  // Set as target all pixels not detected as gradient areas.
-  const short target = -1;
-  for (int y = 0; y < grayscale.rows; ++y) {
-    for (int x = 0; x < grayscale.cols; ++x) {
-      if (canny.at<unsigned char>(y, x) == 0) {
-        labeled_.at<short>(y + 1, x + 1) = target;
-      }
-    }
-  }
+  // Non-zero pixels of the mask separate the blobs from each other: edges
+  // in canny mode, everything but the dark regions in threshold mode.
+  Mat canny =
+      Configuration::Instance().ReadString("segmentation_mode") == "threshold"
+          ? DetectBrightRegions(grayscale)
+          : DetectGradient(grayscale);
 
   const int min_blob_size =
      Configuration::Instance().ReadFloat("blob_min_norm_bbox_size") *
-     grayscale.cols;
+     frameWidth;
 
   const int max_blob_size =
      Configuration::Instance().ReadFloat("blob_max_norm_bbox_size") *
-     grayscale.cols;
+     frameWidth;
 
-  // Label all target areas and extract information of the blob.
-  int currentLabel = 0;
-  for (int y = 0; y < labeled_.rows; ++y) {
-    for (int x = 0; x < labeled_.cols; ++x) {
-      if (labeled_.at<short>(y, x) == target) {
-        BlobInfo info;
-        FloodFill(Point2f(x, y), target, currentLabel++, &info);
-
-        // Reject blobs based on size criteria.
-        if (info.bbox.width > min_blob_size &&
-            info.bbox.width < max_blob_size &&
-            info.bbox.height > min_blob_size &&
-            info.bbox.height < max_blob_size) {
-          blobs_.push_back(info);
-        }
-      }
-    }
-  }
+  Label(canny, min_blob_size, max_blob_size);
 
   CornerHarrisParams params;
   params.blockSize =
@@ -76,6 +107,11 @@ void BlobDetector::Run(const Mat grayscale)
       Configuration::Instance().ReadDouble("corner_harris_free_coefficient");
   params.threshold =
       Configuration::Instance().ReadDouble("corner_harris_threshold");
+  params.responseThreshold =
+      Configuration::Instance().ReadFloat("corner_response_threshold");
+
+  const bool sharedCorners =
+      Configuration::Instance().ReadString("corner_detection_mode") == "shared";
 
   const float verticesMergingDistance =
       Configuration::Instance().ReadFloat("vertices_merging_distance");
@@ -85,67 +121,146 @@ void BlobDetector::Run(const Mat grayscale)
   const float snapSearchFactor =
       Configuration::Instance().ReadFloat("snap_vertices_search_factor");
 
-  // Approximate each blob to a polygon.
-  for (int i = 0; i < blobs_.size(); ++i) {
-    BlobInfo& info = blobs_[i];
-    Mat filled = FillHoles(info);
-    DetectVertices(filled, params, &info);
-    if (info.vertices.size() > 1) {
-      vector<Point2f> reducedVertices;
-      ReduceVertices(info.vertices, &info.vertices, verticesMergingDistance);
-
-      // Only snap vertices to the edges of the blob the polygon has 4 vertices.
-      if (info.vertices.size() == 4) {
-        SnapVerticesToEdgesOfConvexPolygon(filled, info, snapSearchFactor,
-                                           snapWindowSize, &info.vertices);
-        candidates_.push_back(i);
+  vector<Bitmap>& filled = filled_;
+  if (filled.size() < blobs_.Size()) {
+    filled.resize(blobs_.Size());
+  }
+  for (size_t i = 0; i < blobs_.Size(); ++i) {
+    FillHoles(i, &filled[i]);
+  }
+
+  // In shared mode the maxima are already one per corner; per blob the
+  // thresholded response gives clusters that have to be merged.
+  if (sharedCorners) {
+    DetectSharedVertices(filled, params);
+  } else {
+    for (size_t i = 0; i < blobs_.Size(); ++i) {
+      corners_.clear();
+      DetectVertices(filled[i], params, blobs_.bbox[i], &corners_);
+      if (corners_.size() > 1) {
+        ReduceVertices(corners_, &corners_, verticesMergingDistance);
       }
+      blobs_.vertexBegin[i] = blobs_.vertices.size();
+      blobs_.vertexCount[i] = corners_.size();
+      blobs_.vertices.insert(blobs_.vertices.end(), corners_.begin(),
+                             corners_.end());
     }
   }
 
-  if (Configuration::Instance().ReadBool("display_blob_detection")) {
-    Mat debug = Mat(labeled_.rows, labeled_.cols, CV_8UC3);
-    debug.setTo(Scalar(0, 0, 0));
-
-    // Use green channel for original frame.
-    for (int y = 0; y < grayscale.rows; ++y) {
-      for (int x = 0; x < grayscale.cols; ++x) {
-        debug.at<Vec3b>(y + 1, x + 1) = Vec3b(0, grayscale.at<uchar>(y, x), 0);
-      }
+  // Approximate each blob to a polygon.
+  for (size_t i = 0; i < blobs_.Size(); ++i) {
+    // Only snap vertices to the edges of the blob the polygon has 4 vertices.
+    if (blobs_.vertexCount[i] == 4) {
+      SnapVerticesToEdgesOfConvexPolygon(
+          filled[i], blobs_.bbox[i], snapSearchFactor, snapWindowSize,
+          &blobs_.vertices[blobs_.vertexBegin[i]], blobs_.vertexCount[i]);
+      candidates_.push_back(i);
     }
+  }
+}
 
-    for (int i = 0; i < blobs_.size(); ++i) {
-      const BlobInfo& info = blobs_[i];
+void BlobDetector::Label(const Mat& mask, const int minBlobSize,
+                         const int maxBlobSize)
+{
+  // Frame with labels of connected components. The border keeps the flood
+  // fill inside without bounds checks.
+  labeled_ = Image<short>(mask.rows, mask.cols, 1);
+  labeled_.Fill(-2);
 
-      OverlayColor(Vec3b(0, 0, 200), info, &debug);
+  // Set as target all pixels not detected as gradient areas.
+  const short target = -1;
+  const Image<uchar> edges(mask);
+  for (int y = 0; y < mask.rows; ++y) {
+    const uchar* in = edges.Row(y);
+    short* out = labeled_.Row(y);
+    for (int x = 0; x < mask.cols; ++x) {
+      out[x] = in[x] == 0 ? target : -2;
+    }
+  }
 
-      if (Configuration::Instance().ReadBool("display_text")) {
-        stringstream ss;
-        ss << "[v: " << info.vertices.size() << "]";
-        putText(debug, ss.str(), info.origin, FONT_HERSHEY_SIMPLEX, 0.35,
-                Scalar(255, 255, 255), 1);
-      }
+  spanBegin_.assign(mask.rows + 2, numeric_limits<int>::max());
+  spanEnd_.assign(mask.rows + 2, numeric_limits<int>::min());
 
-      if (Configuration::Instance().ReadBool("display_vertices")) {
-        for (int i = 0; i < info.vertices.size(); ++i) {
-          circle(debug, info.vertices[i], 1, Scalar(0, 255, 255));
+  // Label all target areas and extract information of the blob.
+  int currentLabel = 0;
+  for (int y = 0; y < mask.rows + 2; ++y) {
+    for (int x = 0; x < mask.cols + 2; ++x) {
+      if (LabelRow(y)[x] == target) {
+        // Past the last short the labels would wrap around to target, and
+        // the flood fill would never finish. Only a frame of noise gets
+        // there; the rest of it is left unlabeled.
+        if (currentLabel > numeric_limits<short>::max()) {
+          return;
+        }
+        BlobShape shape;
+        const short label = currentLabel++;
+
+        // Reject blobs based on size criteria; too large ones are rejected
+        // by the flood fill as soon as they grow past the limit.
+        const bool small =
+            FloodFill(Point2f(x, y), target, label, maxBlobSize, &shape);
+
+        // The spans are summed in any case, it also resets them.
+        shape.spanArea = 0;
+        for (int row = shape.bbox.y; row < shape.bbox.y + shape.bbox.height;
+             ++row) {
+          shape.spanArea += spanEnd_[row] - spanBegin_[row] + 1;
+          spanBegin_[row] = numeric_limits<int>::max();
+          spanEnd_[row] = numeric_limits<int>::min();
         }
-      }
 
-      if (Configuration::Instance().ReadBool("display_bounding_boxes")) {
-        rectangle(debug, Point2f(info.bbox.x, info.bbox.y),
-                  Point2f(info.bbox.x + info.bbox.width,
-                          info.bbox.y + info.bbox.height),
-                  Scalar(255, 0, 0));
+        if (!small || shape.bbox.width <= minBlobSize ||
+            shape.bbox.height <= minBlobSize) {
+          ++prefilter_.size;
+        } else if (Prefilter(shape)) {
+          blobs_.Add(shape.bbox, shape.numPixels, shape.origin, label);
+        }
       }
     }
+  }
+}
 
-    namedWindow("debug");
-    moveWindow("debug", 0, 0);
-    imshow("debug", debug);
-  } else {
-    destroyWindow("debug");
+bool BlobDetector::Prefilter(const BlobShape& shape)
+{
+  Configuration& config = Configuration::Instance();
+
+  // Glyphs are squares seen at an angle, and mostly dark.
+  const int longSide = max(shape.bbox.width, shape.bbox.height);
+  const int shortSide = min(shape.bbox.width, shape.bbox.height);
+  if (longSide > shortSide * config.ReadFloat("blob_max_aspect_ratio")) {
+    ++prefilter_.aspect;
+    return false;
   }
+
+  if (shape.numPixels <
+      shape.bbox.area() * config.ReadFloat("blob_min_fill_ratio")) {
+    ++prefilter_.fill;
+    return false;
+  }
+
+  // The white cells of a glyph are holes; text and clutter have few or a
+  // lot of them.
+  const int holes = shape.Holes();
+  if (holes < config.ReadInt("blob_min_holes") ||
+      holes > config.ReadInt("blob_max_holes")) {
+    ++prefilter_.holes;
+    return false;
+  }
+
+  // Outlines of a convex quad fill most of the octagon around them.
+  if (shape.spanArea <
+      shape.OctagonArea() * config.ReadFloat("blob_min_solidity")) {
+    ++prefilter_.solidity;
+    return false;
+  }
+
+  ++prefilter_.passed;
+  return true;
+}
+
+PrefilterStats BlobDetector::GetPrefilterStats() const
+{
+  return prefilter_;
 }
 
 int BlobDetector::GetCandidatesCount() const
@@ -153,9 +268,26 @@ int BlobDetector::GetCandidatesCount() const
   return candidates_.size();
 }
 
-const std::vector<cv::Point2f>& BlobDetector::GetVertices(const int index) const
+std::vector<cv::Point2f> BlobDetector::GetVertices(const int index) const
 {
-  return blobs_[candidates_[index]].vertices;
+  const int blob = candidates_[index];
+  const Point2f* begin = blobs_.vertices.data() + blobs_.vertexBegin[blob];
+  return vector<Point2f>(begin, begin + blobs_.vertexCount[blob]);
+}
+
+void BlobDetector::Describe(DebugRecord* record) const
+{
+  // labeled_ is reallocated by every Run, so sharing it is safe.
+  record->labeled = labeled_.AsPaddedMat();
+  record->blobs.resize(blobs_.Size());
+  for (size_t i = 0; i < blobs_.Size(); ++i) {
+    BlobDebugInfo& blob = record->blobs[i];
+    blob.origin = blobs_.origin[i];
+    blob.bbox = blobs_.bbox[i];
+    blob.label = blobs_.label[i];
+    const Point2f* begin = blobs_.vertices.data() + blobs_.vertexBegin[i];
+    blob.vertices.assign(begin, begin + blobs_.vertexCount[i]);
+  }
 }
 
 Mat BlobDetector::DetectGradient(Mat grayscale)
@@ -179,6 +311,41 @@ Mat BlobDetector::DetectGradient(Mat grayscale)
   return canny;
 }
 
+// Marks every pixel that isn't darker than the mean of its neighbourhood by
+// a margin. Glyphs are black on white, so their dark regions become blob
+// seeds directly, and the local mean copes with uneven lighting.
+Mat BlobDetector::DetectBrightRegions(Mat grayscale)
+{
+  const int halfWindow =
+      Configuration::Instance().ReadInt("threshold_window_size") / 2;
+  const int offset = Configuration::Instance().ReadInt("threshold_offset");
+
+  Mat sums;
+  integral(grayscale, sums, CV_32S);
+
+  Mat mask(grayscale.rows, grayscale.cols, CV_8UC1);
+  for (int y = 0; y < grayscale.rows; ++y) {
+    const int y0 = max(y - halfWindow, 0);
+    const int y1 = min(y + halfWindow + 1, grayscale.rows);
+    const int* top = sums.ptr<int>(y0);
+    const int* bottom = sums.ptr<int>(y1);
+    const uchar* pixels = grayscale.ptr<uchar>(y);
+    uchar* out = mask.ptr<uchar>(y);
+
+    for (int x = 0; x < grayscale.cols; ++x) {
+      const int x0 = max(x - halfWindow, 0);
+      const int x1 = min(x + halfWindow + 1, grayscale.cols);
+      const int area = (y1 - y0) * (x1 - x0);
+      const int sum = bottom[x1] - bottom[x0] - top[x1] + top[x0];
+
+      // pixel < mean - offset, without the division.
+      out[x] = (pixels[x] + offset) * area < sum ? 0 : 255;
+    }
+  }
+
+  return mask;
+}
+
 void BlobDetector::ReduceVertices(const vector<Point2f>& vertices,
                                   vector<Point2f>* reducedVertices,
                                   const float mergingDistance)
@@ -233,39 +400,40 @@ int RootNode(const vector<int>& labels, int idx)
   return idx;
 }
 
-void BlobDetector::OverlayColor(const Vec3b color, const BlobInfo& info,
-                                Mat* bgr)
-{
-  // Lazy approach.
-  int ox = info.bbox.x;
-  int oy = info.bbox.y;
-  for (int y = 0; y < info.bbox.height; ++y) {
-    for (int x = 0; x < info.bbox.width; ++x) {
-      if (labeled_.at<short>(oy + y, ox + x) == info.label) {
-        bgr->at<Vec3b>(oy + y, ox + x) = color;
-      }
-    }
-  }
-
-}
-
-void BlobDetector::FloodFill(Point2f node, short target, short replacement,
-                             BlobInfo* info)
+bool BlobDetector::FloodFill(Point2f node, short target, short replacement,
+                             const int maxBlobSize, BlobShape* shape)
 {
   queue<Point2f> q;
   q.push(node);
 
   // Left-Top and Right-Bottom points for the bounding box.
-  Point2f lt(labeled_.cols, labeled_.rows);
+  Point2f lt(labeled_.Cols() + 2, labeled_.Rows() + 2);
   Point2f rb(0, 0);
-  Point2f origin = node;
-  int numPixels = 0;
+  shape->origin = node;
+  shape->numPixels = 0;
+  shape->edges = 0;
+  shape->squares = 0;
+  shape->minSum = shape->minDiff = numeric_limits<int>::max();
+  shape->maxSum = shape->maxDiff = numeric_limits<int>::min();
+  bool rejected = false;
 
   while (!q.empty()) {
     Point2f n = q.front();
     q.pop();
 
-    if (labeled_.at<short>(n.y, n.x) == target) {
+    short* row = LabelRow(n.y);
+    const int x = n.x;
+    if (row[x] == target) {
+      row[x] = replacement;
+      q.push(Point2f(n.x - 1, n.y));
+      q.push(Point2f(n.x + 1, n.y));
+      q.push(Point2f(n.x, n.y - 1));
+      q.push(Point2f(n.x, n.y + 1));
+
+      if (rejected) {
+        continue;
+      }
+
       // Update bounding box.
       lt.x = min(lt.x, n.x);
       lt.y = min(lt.y, n.y);
@@ -273,132 +441,241 @@ void BlobDetector::FloodFill(Point2f node, short target, short replacement,
       rb.y = max(rb.y, n.y);
 
       // Update origin.
-      if (Compare(n, origin) == -1) {
-        origin = n;
+      if (Compare(n, shape->origin) == -1) {
+        shape->origin = n;
       }
 
-      labeled_.at<short>(n.y, n.x) = replacement;
-      q.push(Point2f(n.x - 1, n.y));
-      q.push(Point2f(n.x + 1, n.y));
-      q.push(Point2f(n.x, n.y - 1));
-      q.push(Point2f(n.x, n.y + 1));
-
-      ++numPixels;
+      ++shape->numPixels;
+
+      // Neighbours still to be filled are 4-connected to this pixel, so
+      // target pixels belong to the same component as the filled ones.
+      const short* below = LabelRow(n.y + 1);
+      const bool right = row[x + 1] == target || row[x + 1] == replacement;
+      const bool down = below[x] == target || below[x] == replacement;
+      const bool diagonal =
+          below[x + 1] == target || below[x + 1] == replacement;
+      shape->edges += right + down;
+      shape->squares += right && down && diagonal;
+
+      const int y = n.y;
+      shape->minSum = min(shape->minSum, x + y);
+      shape->maxSum = max(shape->maxSum, x + y);
+      shape->minDiff = min(shape->minDiff, x - y);
+      shape->maxDiff = max(shape->maxDiff, x - y);
+      spanBegin_[y] = min(spanBegin_[y], x);
+      spanEnd_[y] = max(spanEnd_[y], x);
+
+      // Most of the frame is background; once a component is known to be
+      // too large only the labeling is left to do.
+      rejected = rb.x - lt.x + 1 >= maxBlobSize ||
+                 rb.y - lt.y + 1 >= maxBlobSize;
     }
   }
 
-  info->numPixels = numPixels;
-  info->bbox = Rect(lt.x, lt.y, rb.x - lt.x + 1, rb.y - lt.y + 1);
-  info->origin = origin;
-  info->label = replacement;
+  shape->bbox = Rect(lt.x, lt.y, rb.x - lt.x + 1, rb.y - lt.y + 1);
+  return !rejected;
 }
 
-// Returns padded image with 0s for background and 1s for filled blob.
-Mat BlobDetector::FillHoles(const BlobInfo& info)
+void BlobDetector::FillHoles(const int blob, Bitmap* filled)
 {
-  const Rect bbox = info.bbox;
-
-  // There are internal colors; output colors are 0s and 1s.
-  const uchar backgroundColor = 255;
-  const uchar blobColor = 0;
-  const uchar replacementColor = 127;
+  const Rect bbox = blobs_.bbox[blob];
+  const short label = blobs_.label[blob];
 
-  Mat filled(bbox.height + 2, bbox.width + 2, CV_8UC1);
-  filled.setTo(Scalar(backgroundColor));
+  // Padded by a clear pixel on every side, so that the exterior surrounds
+  // the blob.
+  filled->Reset(bbox.height + 2, bbox.width + 2);
 
   int checkSum = 0;  // For sanity check.
   for (int y = 0; y < bbox.height; ++y) {
+    const short* in = LabelRow(bbox.y + y) + bbox.x;
     for (int x = 0; x < bbox.width; ++x) {
-      short value = labeled_.at<short>(bbox.y + y, bbox.x + x);
-      if (value == info.label) {
-        filled.at<uchar>(y + 1, x + 1) = blobColor;
+      if (in[x] == label) {
+        filled->Set(y + 1, x + 1);
         ++checkSum;
       }
     }
   }
 
-  assert(checkSum == info.numPixels);
-
-  queue<Point2f> q;
-  q.push(Point2f(0, 0));  // Start at top-left background pixel.
-
-  while (!q.empty()) {
-    Point2f n = q.front();
-    q.pop();
-
-    if (n.x >= 0 && n.x < filled.cols &&
-        n.y >= 0 && n.y < filled.rows &&
-        filled.at<uchar>(n.y, n.x) == backgroundColor) {
-      filled.at<uchar>(n.y, n.x) = replacementColor;
-      q.push(Point2f(n.x - 1, n.y));
-      q.push(Point2f(n.x + 1, n.y));
-      q.push(Point2f(n.x, n.y - 1));
-      q.push(Point2f(n.x, n.y + 1));
-    }
-  }
-
-  for (int y = 0; y < filled.rows; ++y) {
-    for (int x = 0; x < filled.cols; ++x) {
-        filled.at<uchar>(y, x) =
-            filled.at<uchar>(y, x) == replacementColor ? 0 : 1;
-    }
-  }
+  assert(checkSum == blobs_.numPixels[blob]);
 
-  return filled;
+  filled->FillHoles();
 }
 
-void BlobDetector::DetectVertices(const Mat& blob,
-    const CornerHarrisParams& params, BlobInfo* info)
+void BlobDetector::DetectVertices(const Bitmap& blob,
+    const CornerHarrisParams& params, const Rect& bbox,
+    vector<Point2f>* vertices)
 {
-  Mat harris(blob.size(), CV_32FC1);
-  cornerHarris(blob, harris, params.blockSize, params.apertureSize,
+  Mat mask(blob.Rows(), blob.Cols(), CV_8UC1, Scalar(0));
+  blob.Unpack(mask, 1);
+
+  Mat harris(mask.size(), CV_32FC1);
+  cornerHarris(mask, harris, params.blockSize, params.apertureSize,
                params.freeCoefficient, BORDER_REPLICATE);
   Mat norm, scaled;
   normalize(harris, norm, 0, 255, NORM_MINMAX, CV_32FC1, Mat());
   convertScaleAbs(norm, scaled);
 
-  const Point2f offset(info->bbox.x - 1, info->bbox.y - 1);
-  vector<Point2f> edges;
+  const Point2f offset(bbox.x - 1, bbox.y - 1);
   // The image is padded, skip the padding.
   for (int y = 1; y < scaled.rows - 1; ++y) {
+    const uchar* row = scaled.ptr<uchar>(y);
     for (int x = 1; x < scaled.cols - 1; ++x) {
-      if (scaled.at<uchar>(y, x) > params.threshold) {
-        Point2f p(x, y);
-        edges.push_back(p);
-        info->vertices.push_back(p + offset);
+      if (row[x] > params.threshold) {
+        vertices->push_back(Point2f(x, y) + offset);
       }
     }
   }
 }
 
+void BlobDetector::DetectSharedVertices(const vector<Bitmap>& filled,
+                                        const CornerHarrisParams& params)
+{
+  if (blobs_.Size() == 0) {
+    return;
+  }
+
+  // Blobs touch and nest, so their masks can't share the frame without
+  // losing the edges between them. Each gets a tile of its own instead,
+  // far enough from the others that neither the response nor the maximum
+  // filter reaches across, which makes the response of every tile the one
+  // of its mask alone. Tiles are laid out in shelves about as wide as the
+  // blobs are spread in the frame.
+  const int gap = params.apertureSize / 2 + params.blockSize + 1;
+  int minX = numeric_limits<int>::max(), maxX = 0, widest = 0;
+  for (size_t i = 0; i < blobs_.Size(); ++i) {
+    minX = min(minX, blobs_.bbox[i].x);
+    maxX = max(maxX, blobs_.bbox[i].br().x);
+    widest = max(widest, filled[i].Cols());
+  }
+  const int shelfWidth = max(maxX - minX, widest) + 2 * gap;
+
+  vector<Rect> tiles(blobs_.Size());
+  Point next(gap, gap);
+  int shelfHeight = 0;
+  for (size_t i = 0; i < blobs_.Size(); ++i) {
+    if (next.x + filled[i].Cols() + gap > shelfWidth) {
+      next = Point(gap, next.y + shelfHeight + gap);
+      shelfHeight = 0;
+    }
+    tiles[i] = Rect(next, Size(filled[i].Cols(), filled[i].Rows()));
+    next.x += filled[i].Cols() + gap;
+    shelfHeight = max(shelfHeight, filled[i].Rows());
+  }
+
+  Mat atlas(next.y + shelfHeight + gap, shelfWidth, CV_8UC1, Scalar(0));
+  for (size_t i = 0; i < blobs_.Size(); ++i) {
+    filled[i].Unpack(atlas(tiles[i]), 255);
+  }
+
+  Mat response;
+  cornerHarris(atlas, response, params.blockSize, params.apertureSize,
+               params.freeCoefficient, BORDER_REPLICATE);
+
+  // A pixel is a corner if it is the maximum of its block.
+  Mat dilated;
+  dilate(response, dilated,
+         getStructuringElement(MORPH_RECT,
+                               Size(params.blockSize, params.blockSize)));
+  const float threshold =
+      params.responseThreshold * RightAngleResponse(params);
+  Mat maxima = (response == dilated) & (response > threshold);
+
+  // Ties on a plateau keep the first maximum in raster order.
+  const float minDistance = params.blockSize * params.blockSize / 4.0f;
+  for (size_t i = 0; i < blobs_.Size(); ++i) {
+    const Bitmap& mask = filled[i];
+    const Rect& tile = tiles[i];
+    // Filled masks are padded by one pixel around the bbox of their blob.
+    const Point2f offset(blobs_.bbox[i].x - 1, blobs_.bbox[i].y - 1);
+    vector<Point2f>& vertices = blobs_.vertices;
+    const int begin = vertices.size();
+    for (int y = 0; y < mask.Rows(); ++y) {
+      const uchar* isMaximum = maxima.ptr<uchar>(tile.y + y) + tile.x;
+      for (int x = 0; x < mask.Cols(); ++x) {
+        if (!isMaximum[x]) {
+          continue;
+        }
+
+        // The maximum sits on the corner of the mask, either side of the
+        // edge; it belongs to the blob if the blob is next to it.
+        bool onBlob = false;
+        for (int dy = max(y - 1, 0); dy <= min(y + 1, mask.Rows() - 1); ++dy) {
+          for (int dx = max(x - 1, 0); dx <= min(x + 1, mask.Cols() - 1);
+               ++dx) {
+            onBlob |= mask.Get(dy, dx);
+          }
+        }
+
+        const Point2f vertex = Point2f(x, y) + offset;
+        for (size_t j = begin; j < vertices.size(); ++j) {
+          onBlob &= SquaredDistance(vertex, vertices[j]) > minDistance;
+        }
+        if (onBlob) {
+          vertices.push_back(vertex);
+        }
+      }
+    }
+    blobs_.vertexBegin[i] = begin;
+    blobs_.vertexCount[i] = vertices.size() - begin;
+  }
+}
+
+float BlobDetector::RightAngleResponse(const CornerHarrisParams& params)
+{
+  if (rightAngleResponse_ > 0 &&
+      params.blockSize == rightAngleParams_.blockSize &&
+      params.apertureSize == rightAngleParams_.apertureSize &&
+      params.freeCoefficient == rightAngleParams_.freeCoefficient) {
+    return rightAngleResponse_;
+  }
+
+  // A square as far from the border and its corners as far from each other
+  // as the tiles of DetectSharedVertices.
+  const int margin = params.apertureSize / 2 + params.blockSize + 1;
+  Mat square(4 * margin, 4 * margin, CV_8UC1, Scalar(0));
+  square(Rect(margin, margin, 2 * margin, 2 * margin)).setTo(Scalar(255));
+  Mat response;
+  cornerHarris(square, response, params.blockSize, params.apertureSize,
+               params.freeCoefficient, BORDER_REPLICATE);
+  double peak = 0;
+  minMaxLoc(response, nullptr, &peak);
+
+  rightAngleParams_ = params;
+  rightAngleResponse_ = peak;
+  return rightAngleResponse_;
+}
+
 void BlobDetector::SnapVerticesToEdgesOfConvexPolygon(
-    const Mat& blob,
-    const BlobInfo& info,
+    const Bitmap& blob,
+    const Rect& bbox,
     const float snapSearchFactor,
     const int windowSize,
-    vector<Point2f>* vertices)
+    Point2f* vertices,
+    const int count)
 {
   const int halfWindowSize = windowSize >> 1;
-  const int halfSearchSize = (max(blob.rows, blob.cols) * snapSearchFactor) / 2;
-  const Point2f offset(info.bbox.x - 1, info.bbox.y - 1);
+  const int halfSearchSize =
+      (max(blob.Rows(), blob.Cols()) * snapSearchFactor) / 2;
+  const Point2f offset(bbox.x - 1, bbox.y - 1);
 
-  for (auto& vertice : *vertices)
+  for (int i = 0; i < count; ++i)
   {
+    Point2f& vertice = vertices[i];
     const int xini =
       max(static_cast<int>(vertice.x - offset.x - halfSearchSize), 0);
     const int xend =
-      min(static_cast<int>(vertice.x - offset.x + halfSearchSize), blob.cols);
+      min(static_cast<int>(vertice.x - offset.x + halfSearchSize), blob.Cols());
     const int yini =
       max(static_cast<int>(vertice.y - offset.y - halfSearchSize), 0);
     const int yend =
-      min(static_cast<int>(vertice.y - offset.y + halfSearchSize), blob.rows);
+      min(static_cast<int>(vertice.y - offset.y + halfSearchSize), blob.Rows());
 
     Point2f best = vertice;
     int minSum = numeric_limits<int>::max();
 
     for (int y = yini; y < yend; ++y) {
       for (int x = xini; x < xend; ++x) {
-        if (blob.at<uchar>(y, x) == 1) {
+        if (blob.Get(y, x)) {
           int sum = SumBlock(blob, x, y, halfWindowSize, minSum);
           if (sum < minSum) {
             vertice = Point2f(x, y) + offset;
@@ -410,22 +687,20 @@ void BlobDetector::SnapVerticesToEdgesOfConvexPolygon(
   }
 }
 
-int BlobDetector::SumBlock(const Mat img, const int x, const int y,
+int BlobDetector::SumBlock(const Bitmap& img, const int x, const int y,
                            const int halfWindowSize,
                            const int earlyTerminationSum)
 {
   const int xini = max(x - halfWindowSize, 0);
-  const int xend = min(x + halfWindowSize, img.cols);
+  const int xend = min(x + halfWindowSize, img.Cols());
   const int yini = max(y - halfWindowSize, 0);
-  const int yend = min(y + halfWindowSize, img.rows);
+  const int yend = min(y + halfWindowSize, img.Rows());
 
   int acc = 0;
   for (int y = yini; y < yend; ++y) {
-    for (int x = xini; x < xend; ++x) {
-      acc += img.at<uchar>(y, x);
-      if (acc >= earlyTerminationSum) {
-        return numeric_limits<int>::max();
-      }
+    acc += img.Count(y, xini, xend);
+    if (acc >= earlyTerminationSum) {
+      return numeric_limits<int>::max();
     }
   }
 
@@ -2,13 +2,65 @@
 
 #include "opencv2/opencv.hpp"
 
-struct BlobInfo
+#include "bitmap.h"
+#include "debug_record.h"
+#include "image.h"
+
+// Statistics of the blobs kept by the labeling, one column per field: blob
+// i is row i of every column. The vertices of all blobs share one pool, blob
+// i owning vertexCount[i] of them from vertexBegin[i] on. Clearing keeps the
+// capacity, so steady state runs don't allocate.
+struct BlobTable
+{
+  std::vector<cv::Rect> bbox;
+  std::vector<int> numPixels;
+  std::vector<cv::Point2f> origin;
+  std::vector<short> label;
+  std::vector<int> vertexBegin;
+  std::vector<int> vertexCount;
+  std::vector<cv::Point2f> vertices;
+
+  size_t Size() const;
+  void Clear();
+  void Add(const cv::Rect& bbox, const int numPixels,
+           const cv::Point2f& origin, const short label);
+};
+
+// What labeling measures of a blob while filling it, enough to reject most
+// blobs that can't be glyphs before any per-blob image work.
+struct BlobShape
 {
-  cv::Point2f origin;
   cv::Rect bbox;
   int numPixels;
-  short label;
-  std::vector<cv::Point2f> vertices;
+  cv::Point2f origin;
+  // Edges and 2x2 squares of the 4-connected pixel graph. With the pixels
+  // they give the Euler number, one minus the number of holes.
+  int edges;
+  int squares;
+  // Extremes of x + y and x - y, which cut the corners of the bbox down to
+  // an octagon around the convex hull.
+  int minSum;
+  int maxSum;
+  int minDiff;
+  int maxDiff;
+  // Sum of the spans from the first to the last pixel of every row, i.e.
+  // the area with the holes filled along rows.
+  int spanArea;
+
+  int Holes() const;
+  int OctagonArea() const;
+};
+
+// Blobs rejected by each stage of the prefilter cascade, in the order the
+// stages run, and the ones that passed, since the detector was created.
+struct PrefilterStats
+{
+  long size;
+  long aspect;
+  long fill;
+  long holes;
+  long solidity;
+  long passed;
 };
 
 class BlobDetector
@@ -18,45 +70,95 @@ class BlobDetector
   ~BlobDetector();
 
   void Run(const cv::Mat frame);
+  // Runs on a region of a frame frameWidth pixels wide; the blob size
+  // limits stay relative to the whole frame. Vertices are region
+  // coordinates.
+  void Run(const cv::Mat region, const int frameWidth);
   int GetCandidatesCount() const;
-  const std::vector<cv::Point2f>& GetVertices(const int index) const;
+  std::vector<cv::Point2f> GetVertices(const int index) const;
+  // Adds the blobs of the last run to a record for the DebugVisualizer.
+  void Describe(DebugRecord* record) const;
+  PrefilterStats GetPrefilterStats() const;
 
  private:
+  // Benchmarks measure the private stages one by one.
+  friend class StageBenchmark;
+
   struct CornerHarrisParams
   {
     int blockSize;
     int apertureSize;
     double freeCoefficient;
+    // Per blob mode: threshold on the response normalized to 0..255.
     int threshold;
+    // Shared mode: threshold on the response as a fraction of the response
+    // at the corner of a right angle, the same for every blob.
+    float responseThreshold;
   };
 
-  cv::Mat labeled_;
-  std::vector<BlobInfo> blobs_;
+  // Labels of the last frame, with a border of one pixel. Blob coordinates
+  // count from the top-left corner of the border, see LabelRow.
+  Image<short> labeled_;
+  BlobTable blobs_;
   std::vector<int> candidates_;
+  // Vertices of the blob being approximated, before they go to the pool.
+  std::vector<cv::Point2f> corners_;
+  // Hole-filled masks of the blobs, reused from frame to frame.
+  std::vector<Bitmap> filled_;
+  // First and last pixel of each row of labeled_ touched by the flood fill
+  // of the current blob; reset after each blob.
+  std::vector<int> spanBegin_;
+  std::vector<int> spanEnd_;
+  PrefilterStats prefilter_;
+  // Parameters rightAngleResponse_ was computed with.
+  CornerHarrisParams rightAngleParams_;
+  float rightAngleResponse_;
 
+  // Row y of labeled_ in blob coordinates, border included.
+  short* LabelRow(const int y) { return labeled_.Row(y - 1) - 1; }
   cv::Mat DetectGradient(cv::Mat frame);
+  cv::Mat DetectBrightRegions(cv::Mat frame);
   void ReduceVertices(const std::vector<cv::Point2f>& vertices,
                       std::vector<cv::Point2f>* reducedVertices,
                       const float mergingDistance);
-  void SnapVerticesToEdgesOfConvexPolygon(const cv::Mat& blob,
-                                          const BlobInfo& info,
+  void SnapVerticesToEdgesOfConvexPolygon(const Bitmap& blob,
+                                          const cv::Rect& bbox,
                                           const float snapSearchFactor,
                                           const int windowSize,
-                                          std::vector<cv::Point2f>* vertices);
-  void FloodFill(cv::Point2f node, short target, short replacement,
-                 BlobInfo* info);
-  cv::Mat FillHoles(const BlobInfo& info);
-  void DetectVertices(const cv::Mat& blob, const CornerHarrisParams& params,
-                      BlobInfo* info);
-  int SumBlock(const cv::Mat img, const int x, const int y,
+                                          cv::Point2f* vertices,
+                                          const int count);
+  // Labels the connected components of the zero pixels of mask into
+  // labeled_ and keeps the blobs whose bbox is within the size limits and
+  // that pass the prefilter cascade.
+  void Label(const cv::Mat& mask, const int minBlobSize, const int maxBlobSize);
+  // Replaces the target component at node. Returns false as soon as its
+  // bbox reaches maxBlobSize; the rest of the component is still replaced,
+  // but its shape is no longer measured.
+  bool FloodFill(cv::Point2f node, short target, short replacement,
+                 const int maxBlobSize, BlobShape* shape);
+  // Runs the cascade from the cheapest test on and counts the rejection.
+  bool Prefilter(const BlobShape& shape);
+  // Mask of the blob with its holes filled, padded by one pixel around its
+  // bbox.
+  void FillHoles(const int blob, Bitmap* filled);
+  void DetectVertices(const Bitmap& blob, const CornerHarrisParams& params,
+                      const cv::Rect& bbox, std::vector<cv::Point2f>* vertices);
+  // Computes a single corner response over the hole-filled masks of all
+  // blobs, filled[i] being the mask of blob i, each kept apart from the
+  // others, and adds to the pool of every blob the local maxima above the
+  // absolute threshold that lie on its mask.
+  void DetectSharedVertices(const std::vector<Bitmap>& filled,
+                            const CornerHarrisParams& params);
+  // Peak response of a right angle of a mask. cornerHarris scales its
+  // response by orders of magnitude with the aperture and block sizes, so
+  // the shared threshold is taken relative to this. Computed again only
+  // when the parameters change.
+  float RightAngleResponse(const CornerHarrisParams& params);
+  int SumBlock(const Bitmap& img, const int x, const int y,
                const int halfWindowSize, const int earlyTerminationSum);
   int SumWindow(const cv::Mat blob, const cv::Point2f center, int window);
-  void OverlayColor(const cv::Vec3b color, const BlobInfo& info, cv::Mat* bgr);
 };
 
 int Compare(const cv::Point2f& lhs, const cv::Point2f& rhs);
 float SquaredDistance(const cv::Point2f& lhs, const cv::Point2f& rhs);
 int RootNode(const std::vector<int>& labels, int idx);
-
-// For debug porpuses mainly.
-bool IsValid(BlobInfo& blobInfo, cv::Mat frame);
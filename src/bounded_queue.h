@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Queue of limited capacity between a producer that must never wait and a
+// consumer thread. Items pushed while the queue is full are dropped.
+template <typename T>
+class BoundedQueue
+{
+ public:
+  BoundedQueue(const size_t capacity)
+      : capacity_(capacity)
+      , closed_(false)
+      , dropped_(0)
+  {
+  }
+
+  // Moves the item into the queue, or drops it and returns false when full.
+  bool TryPush(T* item)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (closed_ || items_.size() >= capacity_) {
+        ++dropped_;
+        return false;
+      }
+
+      items_.push_back(T());
+      std::swap(items_.back(), *item);
+    }
+    ready_.notify_one();
+
+    return true;
+  }
+
+  // Waits for the next item. Returns false once the queue has been closed.
+  bool Pop(T* item)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (items_.empty() && !closed_) {
+      ready_.wait(lock);
+    }
+
+    if (items_.empty()) {
+      return false;
+    }
+
+    std::swap(*item, items_.front());
+    items_.pop_front();
+
+    return true;
+  }
+
+  // Wakes up the consumer; items still queued are discarded.
+  void Close()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+      items_.clear();
+    }
+    ready_.notify_all();
+  }
+
+  long Dropped()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+  }
+
+ private:
+  const size_t capacity_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<T> items_;
+  bool closed_;
+  long dropped_;
+};
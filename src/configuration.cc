@@ -17,7 +17,7 @@ Configuration& Configuration::Instance()
 }
 
 Configuration::Configuration()
-: idx_(0), quit_(false)
+: idx_(0), generation_(0), quit_(false)
 {
 }
 
@@ -31,10 +31,23 @@ void Configuration::Load(const string& filename)
   reader_ = thread(Reader, this, filename);
 }
 
+void Configuration::LoadOnce(const string& filename)
+{
+  ReadFile(filename);
+}
+
 void Configuration::Stop()
 {
   quit_ = true;
-  reader_.join();
+  if (reader_.joinable()) {
+    reader_.join();
+  }
+}
+
+void Configuration::Set(const string& name, const string& value)
+{
+  variables_[idx_][name] = value;
+  ++generation_;
 }
 
 int Configuration::ReadInt(const string& name)
@@ -79,6 +92,16 @@ string Configuration::ReadString(const string& name)
   return variables_[idx_].at(name);
 }
 
+string Configuration::Dump()
+{
+  stringstream ss;
+  for (auto& variable : variables_[idx_]) {
+    ss << variable.first << " " << variable.second << endl;
+  }
+
+  return ss.str();
+}
+
 void Configuration::Reader(Configuration* instance, const string& filename)
 {
   struct stat st;
@@ -113,4 +136,5 @@ void Configuration::ReadFile(const string& filename)
   }
 
   idx_ = newIdx;
+  ++generation_;
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <map>
 #include <thread>
@@ -10,14 +11,26 @@ class Configuration
   static Configuration& Instance();
   ~Configuration();
 
+  // Reads the file and keeps watching it for changes.
   void Load(const std::string& filename);
+  // Reads the file once, for tools that set values of their own.
+  void LoadOnce(const std::string& filename);
   void Stop();
 
+  // Overrides a value until the file is read again. Not safe while other
+  // threads read the configuration.
+  void Set(const std::string& name, const std::string& value);
+
   int ReadInt(const std::string& name);
   float ReadFloat(const std::string& name);
   double ReadDouble(const std::string& name);
   bool ReadBool(const std::string& name);
   std::string ReadString(const std::string& name);
+  // Current values in the format of the configuration file.
+  std::string Dump();
+  // Changes whenever the file is read or a value set, so that what is built
+  // from values only needs to be rebuilt then.
+  long Generation() const { return generation_; }
 
  private:
   Configuration();
@@ -27,5 +40,6 @@ class Configuration
   std::thread reader_;
   std::map<std::string, std::string> variables_[2];
   int idx_;
+  std::atomic<long> generation_;
   bool quit_;
 };
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+struct BlobDebugInfo
+{
+  cv::Point2f origin;
+  cv::Rect bbox;
+  short label;
+  std::vector<cv::Point2f> vertices;
+};
+
+// What the detector hands over to the visualizer for one frame. Images are
+// shared handles to buffers the detector doesn't write to again, so
+// publishing a record copies no pixels.
+struct DebugRecord
+{
+  cv::Mat input;
+  cv::Mat grayscale;
+  // Padded label image of BlobDetector; blob coordinates refer to it.
+  cv::Mat labeled;
+  std::vector<BlobDebugInfo> blobs;
+  // Cells sampled by GlyphValidator and the schemas read from them.
+  std::vector<cv::Mat> cellMaps;
+  std::vector<std::string> schemas;
+};
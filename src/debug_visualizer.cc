@@ -0,0 +1,158 @@
+#include "debug_visualizer.h"
+
+#include <iostream>
+#include <sstream>
+
+#include "configuration.h"
+
+using namespace cv;
+using namespace std;
+
+// Records waiting to be drawn; the detector drops frames beyond that.
+static const size_t QUEUE_CAPACITY = 2;
+
+DebugVisualizer::DebugVisualizer()
+    : queue_(QUEUE_CAPACITY)
+    , inputWindowOpen_(false)
+    , blobWindowOpen_(false)
+    , cellWindowOpen_(false)
+{
+  thread_ = thread(Worker, this);
+}
+
+DebugVisualizer::~DebugVisualizer()
+{
+}
+
+void DebugVisualizer::Stop()
+{
+  queue_.Close();
+  thread_.join();
+}
+
+bool DebugVisualizer::Enabled()
+{
+  Configuration& config = Configuration::Instance();
+  return config.ReadBool("display_input_frame") ||
+         config.ReadBool("display_blob_detection") ||
+         config.ReadBool("display_glyph_cells");
+}
+
+bool DebugVisualizer::Publish(DebugRecord* record)
+{
+  return queue_.TryPush(record);
+}
+
+void DebugVisualizer::Worker(DebugVisualizer* instance)
+{
+  DebugRecord record;
+  while (instance->queue_.Pop(&record)) {
+    instance->Show(record);
+    record = DebugRecord();
+  }
+}
+
+void DebugVisualizer::Show(const DebugRecord& record)
+{
+  Configuration& config = Configuration::Instance();
+
+  const bool showInput =
+      config.ReadBool("display_input_frame") && !record.input.empty();
+  UpdateWindow("input", showInput ? record.input : Mat(), showInput,
+               &inputWindowOpen_);
+
+  const bool showBlobs =
+      config.ReadBool("display_blob_detection") && !record.labeled.empty();
+  UpdateWindow("debug", showBlobs ? DrawBlobs(record) : Mat(), showBlobs,
+               &blobWindowOpen_);
+
+  const bool showCells =
+      config.ReadBool("display_glyph_cells") && !record.cellMaps.empty();
+  UpdateWindow("cells", showCells ? DrawCells(record) : Mat(), showCells,
+               &cellWindowOpen_);
+
+  if (showCells) {
+    for (auto& schema : record.schemas) {
+      cout << "Schema is " << schema << endl;
+    }
+  }
+
+  // Lets HighGUI process its events and repaint the windows.
+  waitKey(1);
+}
+
+Mat DebugVisualizer::DrawBlobs(const DebugRecord& record)
+{
+  Configuration& config = Configuration::Instance();
+  const Mat& labeled = record.labeled;
+  const Mat& grayscale = record.grayscale;
+
+  // Use green channel for original frame.
+  Mat debug = Mat::zeros(labeled.rows, labeled.cols, CV_8UC3);
+  vector<Mat> channels;
+  channels.push_back(Mat::zeros(grayscale.rows, grayscale.cols, CV_8UC1));
+  channels.push_back(grayscale);
+  channels.push_back(channels[0]);
+  Mat roi = debug(Rect(1, 1, grayscale.cols, grayscale.rows));
+  merge(channels, roi);
+
+  const bool displayText = config.ReadBool("display_text");
+  const bool displayVertices = config.ReadBool("display_vertices");
+  const bool displayBoxes = config.ReadBool("display_bounding_boxes");
+
+  for (auto& info : record.blobs) {
+    Mat blob = debug(info.bbox);
+    blob.setTo(Scalar(0, 0, 200), labeled(info.bbox) == info.label);
+
+    if (displayText) {
+      stringstream ss;
+      ss << "[v: " << info.vertices.size() << "]";
+      putText(debug, ss.str(), info.origin, FONT_HERSHEY_SIMPLEX, 0.35,
+              Scalar(255, 255, 255), 1);
+    }
+
+    if (displayVertices) {
+      for (auto& vertex : info.vertices) {
+        circle(debug, vertex, 1, Scalar(0, 255, 255));
+      }
+    }
+
+    if (displayBoxes) {
+      rectangle(debug, Point2f(info.bbox.x, info.bbox.y),
+                Point2f(info.bbox.x + info.bbox.width,
+                        info.bbox.y + info.bbox.height),
+                Scalar(255, 0, 0));
+    }
+  }
+
+  return debug;
+}
+
+Mat DebugVisualizer::DrawCells(const DebugRecord& record)
+{
+  // All sampled cell maps side by side.
+  Mat cells = record.cellMaps[0];
+  for (size_t i = 1; i < record.cellMaps.size(); ++i) {
+    Mat next;
+    hconcat(cells, record.cellMaps[i], next);
+    cells = next;
+  }
+
+  return cells;
+}
+
+void DebugVisualizer::UpdateWindow(const string& name, const Mat& image,
+                                   const bool show, bool* open)
+{
+  if (show) {
+    if (!*open) {
+      namedWindow(name);
+      moveWindow(name, 0, 0);
+      *open = true;
+    }
+    imshow(name, image);
+  } else if (*open) {
+    destroyWindow(name);
+    *open = false;
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <thread>
+
+#include "bounded_queue.h"
+#include "debug_record.h"
+
+// Draws and shows the debug windows on its own thread, so the detector only
+// pays for collecting a DebugRecord and never waits on HighGUI.
+class DebugVisualizer
+{
+ public:
+  DebugVisualizer();
+  ~DebugVisualizer();
+
+  void Stop();
+  // Whether any debug window is enabled in the configuration.
+  static bool Enabled();
+  // Takes over the record unless the visualizer is still busy with
+  // previous ones, in which case the record is dropped.
+  bool Publish(DebugRecord* record);
+
+ private:
+  static void Worker(DebugVisualizer* instance);
+  void Show(const DebugRecord& record);
+  cv::Mat DrawBlobs(const DebugRecord& record);
+  cv::Mat DrawCells(const DebugRecord& record);
+  // Shows the image in the named window, or closes the window once when
+  // show is false.
+  void UpdateWindow(const std::string& name, const cv::Mat& image,
+                    const bool show, bool* open);
+
+  BoundedQueue<DebugRecord> queue_;
+  std::thread thread_;
+  bool inputWindowOpen_;
+  bool blobWindowOpen_;
+  bool cellWindowOpen_;
+};
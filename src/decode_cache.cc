@@ -0,0 +1,125 @@
+#include "decode_cache.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace cv;
+using namespace std;
+
+DecodeCache::DecodeCache(const size_t capacity, const float epsilon,
+                         const int signatureTolerance)
+    : capacity_(capacity)
+    , epsilon_(epsilon)
+    , signatureTolerance_(signatureTolerance)
+    , hits_(0)
+    , misses_(0)
+{
+}
+
+DecodeCache::~DecodeCache()
+{
+}
+
+bool DecodeCache::Find(const Mat& image, const vector<Point2f>& corners,
+                       Glyph* glyph, int* quarterTurns)
+{
+  auto it = Match(corners);
+  if (it == entries_.end()) {
+    ++misses_;
+    return false;
+  }
+
+  // Same place, but it may be another glyph or the glyph may be occluded.
+  // The quad holds the payload cells and a border one cell wide.
+  Entry& entry = *it;
+  Sample(image, corners, entry.glyph.Size() + 2, &signature_);
+  for (size_t i = 0; i < signature_.size(); ++i) {
+    if (abs(signature_[i] - entry.signature[i]) > signatureTolerance_) {
+      ++misses_;
+      return false;
+    }
+  }
+
+  entries_.splice(entries_.begin(), entries_, it);
+  *glyph = entry.glyph;
+  *quarterTurns = entry.quarterTurns;
+  ++hits_;
+
+  return true;
+}
+
+void DecodeCache::Insert(const Mat& image, const vector<Point2f>& corners,
+                         const Glyph& glyph, const int quarterTurns)
+{
+  if (capacity_ == 0) {
+    return;
+  }
+
+  // A fresh decode at the place of an entry replaces it.
+  auto it = Match(corners);
+  if (it != entries_.end()) {
+    entries_.erase(it);
+  } else if (entries_.size() >= capacity_) {
+    entries_.pop_back();
+  }
+
+  entries_.push_front(Entry());
+  Entry& entry = entries_.front();
+  for (size_t i = 0; i < corners.size(); ++i) {
+    entry.corners[i] = corners[i];
+  }
+  entry.glyph = glyph;
+  entry.quarterTurns = quarterTurns;
+  Sample(image, corners, glyph.Size() + 2, &entry.signature);
+}
+
+long DecodeCache::Hits() const
+{
+  return hits_;
+}
+
+long DecodeCache::Misses() const
+{
+  return misses_;
+}
+
+list<DecodeCache::Entry>::iterator DecodeCache::Match(
+    const vector<Point2f>& corners)
+{
+  // There are only a few dozen entries, so a scan beats any spatial index,
+  // and unlike quantized buckets it can't miss corners that straddle a
+  // bucket edge.
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    bool near = true;
+    for (size_t i = 0; i < corners.size() && near; ++i) {
+      near = fabs(corners[i].x - it->corners[i].x) <= epsilon_ &&
+             fabs(corners[i].y - it->corners[i].y) <= epsilon_;
+    }
+    if (near) {
+      return it;
+    }
+  }
+
+  return entries_.end();
+}
+
+void DecodeCache::Sample(const Mat& image, const vector<Point2f>& corners,
+                         const size_t gridSize, vector<uint8_t>* signature)
+{
+  // Bilinear interpolation inside the quad is close enough to the
+  // homography at cell centers and costs no matrix solve. Both sides of a
+  // comparison are sampled the same way.
+  signature->resize(gridSize * gridSize);
+  for (size_t r = 0; r < gridSize; ++r) {
+    const float v = (r + 0.5f) / gridSize;
+    const Point2f left = corners[0] + (corners[3] - corners[0]) * v;
+    const Point2f right = corners[1] + (corners[2] - corners[1]) * v;
+    for (size_t c = 0; c < gridSize; ++c) {
+      const float u = (c + 0.5f) / gridSize;
+      const Point2f p = left + (right - left) * u;
+      const int x = min(max(static_cast<int>(p.x), 0), image.cols - 1);
+      const int y = min(max(static_cast<int>(p.y), 0), image.rows - 1);
+      (*signature)[r * gridSize + c] = image.at<uint8_t>(y, x);
+    }
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "glyph.h"
+
+// Remembers recent decodes by the position of their quad, so a glyph that
+// barely moved since the last frame doesn't need a homography and a full
+// resampling again. Entries match when every corner is within epsilon of
+// theirs, and are confirmed by a few intensities sampled at the cell
+// centers. The least recently used entry is evicted first.
+class DecodeCache
+{
+ public:
+  DecodeCache(const size_t capacity, const float epsilon,
+              const int signatureTolerance);
+  ~DecodeCache();
+
+  // Looks up the corners, ordered as by GlyphValidator::ReorderPoints. On a
+  // hit returns the dictionary glyph and its rotation decoded before.
+  bool Find(const cv::Mat& image, const std::vector<cv::Point2f>& corners,
+            Glyph* glyph, int* quarterTurns);
+  void Insert(const cv::Mat& image, const std::vector<cv::Point2f>& corners,
+              const Glyph& glyph, const int quarterTurns);
+
+  long Hits() const;
+  long Misses() const;
+
+ private:
+  struct Entry
+  {
+    Entry() : glyph("") {}
+
+    cv::Point2f corners[4];
+    Glyph glyph;
+    int quarterTurns;
+    // Intensities at the centers of the glyph cells, border included, row
+    // by row.
+    std::vector<uint8_t> signature;
+  };
+
+  // The most recently used entry with every corner within epsilon.
+  std::list<Entry>::iterator Match(const std::vector<cv::Point2f>& corners);
+  static void Sample(const cv::Mat& image,
+                     const std::vector<cv::Point2f>& corners,
+                     const size_t gridSize, std::vector<uint8_t>* signature);
+
+  const size_t capacity_;
+  const float epsilon_;
+  const int signatureTolerance_;
+
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::vector<uint8_t> signature_;
+
+  long hits_;
+  long misses_;
+};
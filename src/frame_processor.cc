@@ -0,0 +1,255 @@
+#include "frame_processor.h"
+
+#include <climits>
+
+using namespace cv;
+using namespace std;
+
+// Points per region edge bent through the lens to bound the region.
+static const int OUTLINE_STEPS = 8;
+
+FrameProcessor::FrameProcessor(const string& dictionary)
+    : glyphValidator_(dictionary)
+{
+}
+
+FrameProcessor::~FrameProcessor()
+{
+}
+
+bool FrameProcessor::IsEncoded(const Mat& frame)
+{
+  return frame.rows == 1 && frame.type() == CV_8UC1;
+}
+
+bool FrameProcessor::Process(const Mat& frame, const float factor,
+                             vector<Glyph>* glyphs)
+{
+  glyphs->clear();
+
+  Mat gray;
+  if (!Prepare(frame, factor, Regions(), &gray)) {
+    return false;
+  }
+  Detect(gray, factor, Regions(), INT_MAX, nullptr, nullptr, glyphs);
+
+  return true;
+}
+
+bool FrameProcessor::Prepare(const Mat& frame, const float factor,
+                             const Regions& regions, Mat* gray)
+{
+  if (IsEncoded(frame)) {
+    // Decoded straight to gray at the nearest 1/2^n scale above the
+    // working resolution; only what is left of the factor is resized.
+    const int denominator = JpegDecoder::ScaleDenominator(factor);
+    if (!jpegDecoder_.Decode(frame.ptr<uint8_t>(), frame.total(),
+                             denominator, &gray_)) {
+      return false;
+    }
+    const float rest = factor * denominator;
+    if (rest != 1.0f) {
+      resize(gray_, gray_, Size(gray_.cols * rest, gray_.rows * rest));
+    }
+  } else if (frame.channels() == 1 && factor == 1.0f) {
+    *gray = frame;
+    return true;
+  } else if (frame.channels() == 1) {
+    resize(frame, gray_, Size(frame.cols * factor, frame.rows * factor));
+  } else if (regions.empty()) {
+    // Converted and shrunk in one pass where the factor allows.
+    grayConverter_.Convert(frame, factor, &gray_);
+  } else {
+    PrepareRegions(frame, factor, regions);
+    *gray = gray_;
+    return true;
+  }
+
+  dirty_.assign(1, Rect(Point(0, 0), gray_.size()));
+  *gray = gray_;
+  return true;
+}
+
+void FrameProcessor::PrepareRegions(const Mat& frame, const float factor,
+                                    const Regions& regions)
+{
+  // Only the regions are resized and converted, straight into their place
+  // in the working frame; the rest stays black. Regions move little from
+  // frame to frame, so rather than the whole buffer only what the previous
+  // frame wrote is cleared.
+  const Size size(frame.cols * factor, frame.rows * factor);
+  if (gray_.size() != size || gray_.type() != CV_8UC1) {
+    gray_.create(size, CV_8UC1);
+    dirty_.assign(1, Rect(Point(0, 0), size));
+  }
+  for (auto& rect : dirty_) {
+    gray_(rect).setTo(Scalar(0));
+  }
+
+  RegionRects(regions, factor, size, &dirty_);
+  const Rect bounds(0, 0, frame.cols, frame.rows);
+  for (auto& rect : dirty_) {
+    const Rect source =
+        Rect(Point(cvRound(rect.x / factor), cvRound(rect.y / factor)),
+             Point(cvRound(rect.br().x / factor),
+                   cvRound(rect.br().y / factor))) & bounds;
+    if (source.area() == 0) {
+      continue;
+    }
+
+    Mat target = gray_(rect);
+    if (frame.type() == CV_8UC2) {
+      // YUYV pixels come in pairs sharing their chroma, so the conversion
+      // starts and ends on a pair and only the luma is resized.
+      const Rect pairs = Rect(Point(source.x & ~1, source.y),
+                              Point((source.br().x + 1) & ~1,
+                                    source.br().y)) & bounds;
+      cvtColor(frame(pairs), part_, CV_YUV2GRAY_YUYV);
+      const Mat luma = part_(Rect(source.tl() - pairs.tl(), source.size()));
+      if (factor != 1.0f) {
+        resize(luma, target, rect.size());
+      } else {
+        luma.copyTo(target);
+      }
+    } else {
+      Mat part = frame(source);
+      if (factor != 1.0f) {
+        resize(frame(source), part_, rect.size());
+        part = part_;
+      }
+      cvtColor(part, target, CV_BGR2GRAY);
+    }
+  }
+}
+
+void FrameProcessor::Detect(const Mat& gray, const float factor,
+                            const Regions& regions, const int maxCandidates,
+                            DebugRecord* debug, vector<Point2f>* candidates,
+                            vector<Glyph>* glyphs)
+{
+  glyphs->clear();
+  if (candidates) {
+    candidates->clear();
+  }
+
+  vector<Rect> rects;
+  RegionRects(regions, factor, gray.size(), &rects);
+  const LensModel& lens = glyphValidator_.Lens();
+  const float scale =
+      lens.Enabled() ? lens.Scale(cvRound(gray.cols / factor)) : 1.0f;
+
+  int validated = 0;
+  for (size_t r = 0; r < rects.size(); ++r) {
+    const Rect& rect = rects[r];
+    blobDetector_.Run(gray(rect), gray.cols);
+    if (debug && r == 0) {
+      debug->grayscale = gray(rect);
+      blobDetector_.Describe(debug);
+    }
+
+    for (int i = 0; i < blobDetector_.GetCandidatesCount(); ++i) {
+      vector<Point2f> vertices = blobDetector_.GetVertices(i);
+      Point2f center(0, 0);
+      for (auto& vertex : vertices) {
+        vertex += Point2f(rect.tl());
+        center += vertex * (1.0f / vertices.size());
+      }
+      if (candidates) {
+        candidates->insert(candidates->end(), vertices.begin(),
+                           vertices.end());
+      }
+
+      if (!regions.empty()) {
+        center = center * (1.0f / factor);
+        if (lens.Enabled()) {
+          center = lens.Undistort(center, scale);
+        }
+        if (!InRegions(regions, center)) {
+          continue;
+        }
+      }
+      if (validated >= maxCandidates) {
+        continue;
+      }
+      ++validated;
+
+      Glyph glyph("");
+      if (!glyphValidator_.Validate(gray, vertices, debug, &glyph)) {
+        continue;
+      }
+
+      // Poses are reported in frame coordinates whatever the working
+      // resolution is, so they don't jump when the resolution changes.
+      glyph.ScalePose(1.0 / factor);
+      glyphs->push_back(glyph);
+    }
+  }
+}
+
+void FrameProcessor::RegionRects(const Regions& regions, const float factor,
+                                 const Size& size, vector<Rect>* rects)
+{
+  rects->clear();
+  const Rect frame(Point(0, 0), size);
+  if (regions.empty()) {
+    rects->push_back(frame);
+    return;
+  }
+
+  const LensModel& lens = glyphValidator_.Lens();
+  const float scale =
+      lens.Enabled() ? lens.Scale(cvRound(size.width / factor)) : 1.0f;
+  vector<Point2f> outline;
+  for (auto& region : regions) {
+    if (region.empty()) {
+      continue;
+    }
+    Rect bounds = boundingRect(region);
+    if (lens.Enabled()) {
+      // Straight edges of the region are bent in the working frame.
+      outline.clear();
+      for (size_t i = 0; i < region.size(); ++i) {
+        const Point2f& from = region[i];
+        const Point2f& to = region[(i + 1) % region.size()];
+        for (int step = 0; step < OUTLINE_STEPS; ++step) {
+          const Point2f point =
+              from + (to - from) * (float(step) / OUTLINE_STEPS);
+          outline.push_back(lens.Distort(point, scale));
+        }
+      }
+      bounds = boundingRect(outline);
+    }
+    const Rect rect = Rect(Point(cvFloor(bounds.x * factor),
+                                 cvFloor(bounds.y * factor)),
+                           Point(cvCeil(bounds.br().x * factor),
+                                 cvCeil(bounds.br().y * factor))) & frame;
+    if (rect.area() > 0) {
+      rects->push_back(rect);
+    }
+  }
+
+  // Overlapping rectangles would find the same glyphs twice.
+  for (bool merged = true; merged; ) {
+    merged = false;
+    for (size_t i = 0; i < rects->size() && !merged; ++i) {
+      for (size_t j = i + 1; j < rects->size(); ++j) {
+        if (((*rects)[i] & (*rects)[j]).area() > 0) {
+          (*rects)[i] |= (*rects)[j];
+          rects->erase(rects->begin() + j);
+          merged = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
+bool FrameProcessor::InRegions(const Regions& regions, const Point2f& point)
+{
+  for (auto& region : regions) {
+    if (region.size() >= 3 && pointPolygonTest(region, point, false) >= 0) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "blob_detector.h"
+#include "debug_record.h"
+#include "glyph.h"
+#include "glyph_validator.h"
+#include "gray_converter.h"
+#include "jpeg_decoder.h"
+
+// Detects the glyphs of single frames, without the camera, threads and
+// pacing of GlyphDetector, which runs every frame through one of these as
+// well. Nothing carries over from one frame to the next but scratch buffers
+// and the decode cache, which decode_cache_size 0 turns off, so any number
+// of instances can run at once, one per thread, as long as nobody changes
+// the configuration meanwhile.
+class FrameProcessor
+{
+ public:
+  typedef std::vector<std::vector<cv::Point2f>> Regions;
+
+  FrameProcessor(const std::string& dictionary);
+  ~FrameProcessor();
+
+  // Takes a BGR, YUYV or grayscale frame, or a JPEG image as a single row of
+  // bytes like cameras deliver encoded frames, and processes it at factor
+  // of its size. Poses are in frame coordinates. Returns false if an
+  // encoded frame is corrupt.
+  bool Process(const cv::Mat& frame, const float factor,
+               std::vector<Glyph>* glyphs);
+
+  // The two steps of Process, for callers that restrict detection to
+  // regions or keep the working frame. Regions are polygons in the
+  // coordinates of the poses: frame pixels, undistorted when lens_* sets a
+  // distortion, while the working frame is as the camera saw it.
+  //
+  // Turns frame into the grayscale working frame at factor of its size.
+  // With regions, raw frames only have the bounding rectangles of the
+  // regions converted and the rest is black. *gray is either frame itself
+  // or a buffer that the next call overwrites. Returns false if an encoded
+  // frame is corrupt.
+  bool Prepare(const cv::Mat& frame, const float factor,
+               const Regions& regions, cv::Mat* gray);
+  // Looks for candidates within the rectangles of the regions of a working
+  // frame and validates the ones centered inside a region, at most
+  // maxCandidates of them. Poses are in frame coordinates. When given, the
+  // vertices of all candidates are added to candidates, four each, in
+  // working frame coordinates, and the blobs of the first rectangle and the
+  // sampled cells to debug.
+  void Detect(const cv::Mat& gray, const float factor, const Regions& regions,
+              const int maxCandidates, DebugRecord* debug,
+              std::vector<cv::Point2f>* candidates,
+              std::vector<Glyph>* glyphs);
+
+  long CacheHits() const { return glyphValidator_.CacheHits(); }
+  long CacheMisses() const { return glyphValidator_.CacheMisses(); }
+  PrefilterStats GetPrefilterStats() const
+  {
+    return blobDetector_.GetPrefilterStats();
+  }
+
+  // Encoded frames, from an MJPEG file or a camera in passthrough mode, are
+  // a single row of bytes.
+  static bool IsEncoded(const cv::Mat& frame);
+
+ private:
+  FrameProcessor(const FrameProcessor&);
+  FrameProcessor& operator=(const FrameProcessor&);
+
+  // Bounding rectangles of the regions in working coordinates, through the
+  // lens, clipped to the frame and merged where they overlap. The whole
+  // frame if there are no regions.
+  void RegionRects(const Regions& regions, const float factor,
+                   const cv::Size& size, std::vector<cv::Rect>* rects);
+  static bool InRegions(const Regions& regions, const cv::Point2f& point);
+  // Prepare for raw frames with regions.
+  void PrepareRegions(const cv::Mat& frame, const float factor,
+                      const Regions& regions);
+
+  BlobDetector blobDetector_;
+  GlyphValidator glyphValidator_;
+  JpegDecoder jpegDecoder_;
+  GrayConverter grayConverter_;
+  // Never shares the pixels of a frame passed in.
+  cv::Mat gray_;
+  // The parts of gray_ that may not be black.
+  std::vector<cv::Rect> dirty_;
+  // A region of the frame on its way into gray_.
+  cv::Mat part_;
+};
@@ -1,5 +1,6 @@
 #include "game.h"
 
+#include <algorithm>
 #include <exception>
 
 #include "SDL_image.h"
@@ -7,12 +8,32 @@
 static const int WIDTH = 640;
 static const int HEIGHT = 480;
 
+// The simulation advances in fixed steps independent of the display rate.
+static const double STEP_MS = 1000.0 / 60.0;
+// Upper bound of steps run per tick, so a stall doesn't snowball.
+static const int MAX_STEPS_PER_TICK = 5;
+// Degrees per second the bricks spin.
+static const double BRICK_SPIN_SPEED = 60.0;
+// Cell size of the collision grid, about the size of a brick.
+static const float COLLISION_CELL_SIZE = 64.0f;
+// Initial ball velocity in pixels per second.
+static const float BALL_SPEED_X = 180.0f;
+static const float BALL_SPEED_Y = -140.0f;
+
 using namespace std;
 
 Game::Game()
     : title_("Demo Game Window :: Press 'q' to quit")
     , status_(GameStatus::Play)
     , ticks_(0)
+    , angle_(0.0)
+    , previousAngle_(0.0)
+    , physics_(WIDTH, HEIGHT, COLLISION_CELL_SIZE)
+    , lastTime_(Clock::now())
+    , accumulatorMs_(0.0)
+    , hasPendingInput_(false)
+    , inputLatencySumMs_(0.0)
+    , inputLatencySamples_(0)
 {
   if (SDL_Init(SDL_INIT_EVERYTHING) == -1) {
     LogSdlError(cout, "SDL_Init");
@@ -40,19 +61,123 @@ Game::Game()
 
   SDL_SetRenderDrawColor(renderer_, 75, 175, 185, 255);
 
-  ball_ = LoadTexture("resources/ball.png", renderer_);
-  bricks_.push_back(LoadTexture("resources/brick.png", renderer_));
+  if (!atlas_.Load("resources", renderer_)) {
+    LogSdlError(cout, "TextureAtlas");
+    throw "Texture Atlas";
+  }
+
+  ballSprite_ = atlas_.Find("ball");
+  brickSprite_ = atlas_.Find("brick");
+  if (ballSprite_ == nullptr || brickSprite_ == nullptr) {
+    throw "Missing Sprites";
+  }
+
+  Ball ball;
+  ball.radius = ballSprite_->rect.w / 2.0f;
+  ball.x = WIDTH / 2.0f;
+  ball.y = HEIGHT / 2.0f;
+  ball.vx = BALL_SPEED_X;
+  ball.vy = BALL_SPEED_Y;
+  physics_.SetBall(ball);
+  previousBall_ = ball;
+
+  AddBrick(400, 300);
 }
 
 Game::~Game()
 {
-  SDL_DestroyTexture(ball_);
+  atlas_.Clear();
   SDL_DestroyRenderer(renderer_);
   SDL_DestroyWindow(window_);
   SDL_Quit();
 }
 
 void Game::Tick()
+{
+  ProcessEvents();
+  if (status_ == GameStatus::Exit) {
+    return;
+  }
+
+  const Clock::time_point now = Clock::now();
+  accumulatorMs_ +=
+      chrono::duration<double, milli>(now - lastTime_).count();
+  lastTime_ = now;
+
+  int steps = 0;
+  while (accumulatorMs_ >= STEP_MS && steps < MAX_STEPS_PER_TICK) {
+    Update();
+    accumulatorMs_ -= STEP_MS;
+    ++steps;
+  }
+
+  // Drop the time that couldn't be simulated instead of catching up later.
+  if (steps == MAX_STEPS_PER_TICK) {
+    accumulatorMs_ = 0.0;
+  }
+
+  Render(accumulatorMs_ / STEP_MS);
+}
+
+int Game::MillisecondsUntilNextStep()
+{
+  const double elapsedMs =
+      chrono::duration<double, milli>(Clock::now() - lastTime_).count();
+
+  return max(0, static_cast<int>(STEP_MS - accumulatorMs_ - elapsedMs));
+}
+
+void Game::OnGlyphEvents(const vector<GlyphEvent>& events, const bool resync)
+{
+  if (resync) {
+    tracker_.Clear();
+    while (!glyphBricks_.empty()) {
+      RemoveGlyphBrick(glyphBricks_.begin()->first);
+    }
+  }
+
+  for (auto& event : events) {
+    if (event.type == GlyphLost) {
+      tracker_.Remove(event.track);
+      RemoveGlyphBrick(event.track);
+      continue;
+    }
+
+    Pose pose;
+    pose.center = cv::Point2d(event.x, event.y);
+    pose.angle = event.angle;
+    tracker_.Measure(event.track, pose, event.captured,
+                     event.type == GlyphStopped);
+
+    // Glyphs lying still get no further events, and their tracks may be
+    // too old to be predicted, so their bricks are put back right away.
+    if (resync) {
+      PlaceGlyphBrick(event.track, pose);
+    }
+  }
+
+  // Keep the oldest input not yet on screen.
+  if (!events.empty() && !hasPendingInput_) {
+    pendingInput_ = events.front().captured;
+    hasPendingInput_ = true;
+  }
+}
+
+double Game::AverageInputLatencyMs() const
+{
+  if (inputLatencySamples_ == 0) {
+    return 0.0;
+  }
+
+  return inputLatencySumMs_ / inputLatencySamples_;
+}
+
+PredictionStats Game::GetPredictionStats() const
+{
+  return tracker_.Stats();
+}
+
+void Game::ProcessEvents()
 {
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
@@ -63,68 +188,119 @@ void Game::Tick()
       }
     }
   }
+}
 
-  SDL_RenderClear(renderer_);
+void Game::AddBrick(const float x, const float y)
+{
+  Brick brick;
+  brick.x = x;
+  brick.y = y;
+  brick.body = physics_.AddBrick(BrickBounds(brick));
+  bricks_.push_back(brick);
+}
 
-  for (auto brick : bricks_)
-  {
-    RenderTexture(brick, renderer_, 400, 300, ticks_);
-  }
+Aabb Game::BrickBounds(const Brick& brick) const
+{
+  // Collisions ignore the spin of the sprite.
+  Aabb bounds;
+  bounds.x0 = brick.x;
+  bounds.y0 = brick.y;
+  bounds.x1 = brick.x + brickSprite_->rect.w;
+  bounds.y1 = brick.y + brickSprite_->rect.h;
 
-  SDL_RenderPresent(renderer_);
-  ++ticks_;
+  return bounds;
 }
 
-GameStatus Game::Status()
+void Game::RemoveGlyphBrick(const int track)
 {
-  return status_;
+  auto it = glyphBricks_.find(track);
+  if (it != glyphBricks_.end()) {
+    physics_.RemoveBrick(it->second.body);
+    glyphBricks_.erase(it);
+  }
 }
 
-int Game::LogSdlError(ostream& os, const string& msg)
+void Game::UpdateGlyphBricks()
 {
-  os << msg << " error: " << SDL_GetError() << endl;
-  return 1;
+  // Bricks of glyphs lying still keep their bodies as they are; lost ones
+  // have already been removed by their events.
+  tracker_.PredictActive(Clock::now(), &poses_);
+
+  for (auto& entry : poses_) {
+    PlaceGlyphBrick(entry.first, entry.second);
+  }
 }
 
-SDL_Texture* Game::LoadTexture(const string& file, SDL_Renderer* ren)
+void Game::PlaceGlyphBrick(const int track, const Pose& pose)
 {
-  SDL_Texture* tex = IMG_LoadTexture(ren, file.c_str());
-  if (tex == nullptr) {
-    LogSdlError(cout, "LoadTexture");
-  }
+  auto it = glyphBricks_.find(track);
+  Brick& brick = it != glyphBricks_.end() ? it->second : glyphBricks_[track];
+  brick.x = pose.center.x - brickSprite_->rect.w / 2.0f;
+  brick.y = pose.center.y - brickSprite_->rect.h / 2.0f;
 
-  return tex;
+  if (it == glyphBricks_.end()) {
+    brick.body = physics_.AddBrick(BrickBounds(brick));
+  } else {
+    physics_.MoveBrick(brick.body, BrickBounds(brick));
+  }
 }
 
-void Game::RenderTexture(SDL_Texture* tex, SDL_Renderer* ren,
-                         const int x, const int y, const int w, const int h)
+void Game::Update()
 {
-  SDL_Rect dst;
-  dst.x = x;
-  dst.y = y;
-  dst.w = w;
-  dst.h = h;
-  SDL_RenderCopy(ren, tex, NULL, &dst);
+  UpdateGlyphBricks();
+
+  previousAngle_ = angle_;
+  angle_ += BRICK_SPIN_SPEED * STEP_MS / 1000.0;
+
+  previousBall_ = physics_.GetBall();
+  physics_.Step(STEP_MS / 1000.0);
+
+  ++ticks_;
 }
 
-void Game::RenderTexture(SDL_Texture* tex, SDL_Renderer* ren, int x, int y)
+void Game::Render(const double alpha)
 {
-  int w, h;
-  SDL_QueryTexture(tex, NULL, NULL, &w, &h);
-  RenderTexture(tex, ren, x, y, w, h);
+  SDL_RenderClear(renderer_);
+
+  const double angle = previousAngle_ + (angle_ - previousAngle_) * alpha;
+  for (auto& brick : bricks_)
+  {
+    batch_.Add(*brickSprite_, brick.x, brick.y, angle);
+  }
+
+  // Glyph bricks are drawn at their poses extrapolated to this frame, which
+  // keeps them moving smoothly while detection runs at a lower rate.
+  tracker_.Predict(Clock::now(), &poses_);
+  for (auto& entry : poses_)
+  {
+    const Pose& pose = entry.second;
+    batch_.Add(*brickSprite_, pose.center.x - brickSprite_->rect.w / 2.0f,
+               pose.center.y - brickSprite_->rect.h / 2.0f, pose.angle);
+  }
+
+  const Ball& ball = physics_.GetBall();
+  const float ballX = previousBall_.x + (ball.x - previousBall_.x) * alpha;
+  const float ballY = previousBall_.y + (ball.y - previousBall_.y) * alpha;
+  batch_.Add(*ballSprite_, ballX - ball.radius, ballY - ball.radius, 0.0);
+  batch_.Flush(renderer_, atlas_.Texture());
+
+  SDL_RenderPresent(renderer_);
+
+  if (hasPendingInput_) {
+    inputLatencySumMs_ +=
+        chrono::duration<double, milli>(Clock::now() - pendingInput_).count();
+    ++inputLatencySamples_;
+    hasPendingInput_ = false;
+  }
 }
 
-void Game::RenderTexture(SDL_Texture* tex, SDL_Renderer* ren, int x, int y,
-                         double angle)
+GameStatus Game::Status()
 {
-  int w, h;
-  SDL_QueryTexture(tex, NULL, NULL, &w, &h);
-  SDL_Rect dst;
-  dst.x = x;
-  dst.y = y;
-  dst.w = w;
-  dst.h = h;
-  SDL_RenderCopyEx(ren, tex, NULL, &dst, angle, NULL, SDL_FLIP_NONE);
+  return status_;
 }
 
-
+int Game::LogSdlError(ostream& os, const string& msg)
+{
+  os << msg << " error: " << SDL_GetError() << endl;
+  return 1;
+}
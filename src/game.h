@@ -1,33 +1,67 @@
 #pragma once
 
+#include <chrono>
 #include <iostream>
+#include <map>
 #include <vector>
 
 #include "SDL.h"
 
+#include "glyph_tracker.h"
+#include "physics.h"
+#include "pose_tracker.h"
+#include "sprite_batch.h"
+#include "texture_atlas.h"
+
 enum GameStatus
 {
   Play,
   Exit
 };
 
+struct Brick
+{
+  // Top-left corner on screen.
+  float x, y;
+  // Id of its collision box in Physics.
+  int body;
+};
+
 class Game
 {
  public:
+  typedef std::chrono::steady_clock Clock;
+
   Game();
   ~Game();
   GameStatus Status();
+  // Handles input, advances the simulation in fixed steps for the time that
+  // has passed and renders a frame interpolated between the last two steps.
   void Tick();
+  // Time left until the next simulation step is due. The main loop sleeps
+  // for at most this long while waiting for new detections.
+  int MillisecondsUntilNextStep();
+  // Applies the track events of the detector. Bricks follow the tracks with
+  // poses extrapolated to the time they are drawn; only tracks that changed
+  // recently are touched. After a resync the events describe every live
+  // track and replace what was known before. The latency of the input is
+  // measured when the next frame is presented.
+  void OnGlyphEvents(const std::vector<GlyphEvent>& events, const bool resync);
+  double AverageInputLatencyMs() const;
+  PredictionStats GetPredictionStats() const;
 
  private:
   int LogSdlError(std::ostream& os, const std::string& msg);
 
-  SDL_Texture* LoadTexture(const std::string& file, SDL_Renderer* ren);
-  void RenderTexture(SDL_Texture* tex, SDL_Renderer* ren,
-                     const int x, const int y, const int w, const int h);
-  void RenderTexture(SDL_Texture* tex, SDL_Renderer* ren, const int x, const int y);
-  void RenderTexture(SDL_Texture* tex, SDL_Renderer* ren, const int x, const int y,
-                     const double angle);
+  void AddBrick(const float x, const float y);
+  void RemoveGlyphBrick(const int track);
+  // Moves the brick of a track to a pose, creating it for a new track.
+  void PlaceGlyphBrick(const int track, const Pose& pose);
+  void UpdateGlyphBricks();
+  Aabb BrickBounds(const Brick& brick) const;
+  void ProcessEvents();
+  void Update();
+  void Render(const double alpha);
 
 
   const std::string title_;
@@ -35,6 +69,29 @@ class Game
   long ticks_;
   SDL_Window* window_;
   SDL_Renderer* renderer_;
-  SDL_Texture* ball_;
-  std::vector<SDL_Texture*> bricks_;
+  // All sprites live in one atlas and are drawn through a single batch.
+  TextureAtlas atlas_;
+  SpriteBatch batch_;
+  const AtlasSprite* ballSprite_;
+  const AtlasSprite* brickSprite_;
+  std::vector<Brick> bricks_;
+  // Bricks driven by glyphs, keyed by track id.
+  PoseTracker tracker_;
+  std::map<int, Brick> glyphBricks_;
+  std::map<int, Pose> poses_;
+
+  // Simulation state of the current and the previous step, used to
+  // interpolate when rendering between steps.
+  double angle_;
+  double previousAngle_;
+  Physics physics_;
+  Ball previousBall_;
+
+  Clock::time_point lastTime_;
+  double accumulatorMs_;
+
+  bool hasPendingInput_;
+  Clock::time_point pendingInput_;
+  double inputLatencySumMs_;
+  long inputLatencySamples_;
 };
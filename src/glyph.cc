@@ -5,6 +5,7 @@
 #include <fstream>
 
 Glyph::Glyph(const std::string& glyph_schema)
+  : id_(-1), center_(0, 0), angle_(0.0)
 {
   size_t schema_len = glyph_schema.size();
   size_t side_len = sqrt(schema_len);
@@ -13,46 +14,112 @@ Glyph::Glyph(const std::string& glyph_schema)
     /// throw new std::exception("Schema doesn't define a square glyph");
   }
   size_ = side_len;
-  schema_ = new bool[size_ * size_];
-  for (size_t i = 0; i < glyph_schema.size(); ++i)
+  schema_.resize(size_ * size_);
+  for (size_t i = 0; i < schema_.size(); ++i)
   {
-    schema_[i] = glyph_schema[i] == 'b' ? true : false;
+    // Dictionaries use either b/w or t/f for black/white cells.
+    schema_[i] = glyph_schema[i] == 'b' || glyph_schema[i] == 't';
+  }
+}
+
+Glyph::Glyph(size_t size, uint64_t code)
+  : size_(size), schema_(size * size), id_(-1), center_(0, 0), angle_(0.0)
+{
+  for (size_t i = 0; i < schema_.size() && i < 64; ++i)
+  {
+    schema_[i] = (code >> i) & 1;
   }
 }
 
 Glyph::~Glyph()
 {
-  delete[] schema_;
 }
 
 bool Glyph::operator==(const Glyph& glyph) const
 {
-  // TODO: add support for matching glyphs not
-  // oriented in the same way.
-  if (glyph.size_ == size_)
+  // Orientation is not taken into account, compare against Rotated()
+  // glyphs to match glyphs in any orientation.
+  return glyph.size_ == size_ && glyph.schema_ == schema_;
+}
+
+Glyph Glyph::Rotated(int quarter_turns) const
+{
+  Glyph rotated(*this);
+  for (int turn = 0; turn < (quarter_turns & 3); ++turn)
+  {
+    const std::vector<bool> previous = rotated.schema_;
+    for (size_t r = 0; r < size_; ++r)
+    {
+      for (size_t c = 0; c < size_; ++c)
+      {
+        rotated.schema_[r * size_ + c] = previous[(size_ - 1 - c) * size_ + r];
+      }
+    }
+  }
+  return rotated;
+}
+
+size_t Glyph::Size() const
+{
+  return size_;
+}
+
+uint64_t Glyph::Code() const
+{
+  uint64_t code = 0;
+  for (size_t i = 0; i < schema_.size() && i < 64; ++i)
   {
-    for(size_t i = 0; i < size_; ++i)
+    if (schema_[i])
     {
-      if (schema_[i] != glyph.schema_[i])
-        return false;
+      code |= uint64_t(1) << i;
     }
-    return true;
   }
-  return false;
+  return code;
 }
 
 int Glyph::Id() const
 {
-  return -1;
+  return id_;
+}
+
+void Glyph::SetId(int id)
+{
+  id_ = id;
 }
 
 double Glyph::Angle() const
 {
-  return 0.0;
+  return angle_;
 }
 
 cv::Point2d Glyph::Center() const
 {
-  return cv::Point2d(300, 300);
+  return center_;
+}
+
+void Glyph::SetPose(const std::vector<cv::Point2f>& corners)
+{
+  // The center is where the diagonals cross, which unlike the mean of the
+  // corners is preserved by perspective.
+  const cv::Point2d p0 = corners[0], p1 = corners[1];
+  const cv::Point2d p2 = corners[2], p3 = corners[3];
+  const cv::Point2d d0 = p2 - p0, d1 = p3 - p1;
+  const double denominator = d0.x * d1.y - d0.y * d1.x;
+  if (std::fabs(denominator) > 1e-9)
+  {
+    const double t = ((p1.x - p0.x) * d1.y - (p1.y - p0.y) * d1.x) / denominator;
+    center_ = p0 + d0 * t;
+  }
+  else
+  {
+    center_ = (p0 + p1 + p2 + p3) * 0.25;
+  }
+
+  angle_ = atan2(p1.y - p0.y, p1.x - p0.x) * 180.0 / M_PI;
+}
+
+void Glyph::ScalePose(double factor)
+{
+  center_ = center_ * factor;
 }
 
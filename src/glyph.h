@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "opencv2/opencv.hpp"
 
@@ -10,18 +12,41 @@ class Glyph
 {
   public:
     Glyph(const std::string& glyph_schema);
+    // Glyph of size x size cells from its code, see Code().
+    Glyph(size_t size, uint64_t code);
     ~Glyph();
 
     bool operator==(const Glyph& glyph) const;
 
+    // Returns the glyph turned clockwise by the given number of quarter turns.
+    Glyph Rotated(int quarter_turns) const;
+
+    // Number of cells along each side.
+    size_t Size() const;
+    // Cells packed row-major, bit r * Size() + c is set for a black cell.
+    // Only defined for glyphs of at most 8x8 cells.
+    uint64_t Code() const;
+
     int Id() const;
+    void SetId(int id);
+
+    // Angle in degrees of the top edge of the glyph, clockwise in image
+    // coordinates like SDL_RenderCopyEx expects.
     double Angle() const;
     cv::Point2d Center() const;
+    // Sets the pose from the image corners of the glyph, clockwise and
+    // starting at the corner next to the first cell of the schema.
+    void SetPose(const std::vector<cv::Point2f>& corners);
+    // Scales the pose, e.g. from a resized frame back to camera coordinates.
+    void ScalePose(double factor);
 
   private:
     size_t size_;
     // true represents a cell with black color - false represents white
     // color cell.
-    bool* schema_;
+    std::vector<bool> schema_;
+    int id_;
+    cv::Point2d center_;
+    double angle_;
 };
 
@@ -1,23 +1,66 @@
 #include "glyph_detector.h"
 
+#include <algorithm>
+#include <climits>
 #include <exception>
 #include <iostream>
 
+#include "activity_governor.h"
 #include "blob_detector.h"
 #include "configuration.h"
+#include "frame_processor.h"
 
 using namespace cv;
 using namespace std;
 
+// Number of consecutive deadline misses before lowering quality, and of
+// consecutive frames with headroom before restoring it.
+static const int MISSES_TO_DEGRADE = 3;
+static const int FRAMES_TO_RESTORE = 30;
+// Track events the consumer may fall behind by before it has to resync.
+static const size_t EVENT_QUEUE_CAPACITY = 4096;
+
 GlyphDetector::GlyphDetector(string filename)
-    : videoCapture_(CV_CAP_ANY)  // It has to be opened from the main thread.
-    , quit_(false)
-    , glyphValidator_(filename)
+    : quit_(false)
+    , sequence_(0)
+    , events_(EVENT_QUEUE_CAPACITY)
+    , eventsOverflowed_(false)
+    , processor_(filename)
+    , hasFrame_(false)
+    , framesCaptured_(0)
+    , framesDropped_(0)
+    , stats_()
+    , missStreak_(0)
+    , headroomStreak_(0)
 {
-  if (!videoCapture_.isOpened()) {
-    throw "Unable to open camera";
+  const string source =
+      Configuration::Instance().ReadString("input_source");
+  if (source != "camera") {
+    fileSource_.reset(new MjpegReader(source));
+  } else {
+    // It has to be opened from the main thread.
+    videoCapture_.open(CV_CAP_ANY);
+    if (!videoCapture_.isOpened()) {
+      throw "Unable to open camera";
+    }
+
+    // Asks for the compressed frames, so that the worker can decode them
+    // at the working resolution. Backends that can't pass them through
+    // keep delivering BGR frames, which are handled as before.
+    if (Configuration::Instance().ReadBool("capture_mjpeg_passthrough")) {
+      videoCapture_.set(CV_CAP_PROP_FOURCC, CV_FOURCC('M', 'J', 'P', 'G'));
+      videoCapture_.set(CV_CAP_PROP_CONVERT_RGB, 0);
+    }
   }
 
+  Configuration& config = Configuration::Instance();
+  if (config.ReadBool("recorder_enabled")) {
+    recorder_.reset(new SessionRecorder(
+        config.ReadString("recorder_path"),
+        size_t(config.ReadInt("recorder_size_mb")) << 20));
+  }
+
+  captureThread_ = thread(Capture, this);
   thread_ = thread(Worker, this);
 }
 
@@ -27,8 +70,18 @@ GlyphDetector::~GlyphDetector()
 
 void GlyphDetector::Stop()
 {
-  quit_ = true;
+  {
+    lock_guard<mutex> lock(frameMutex_);
+    quit_ = true;
+  }
+  frameReady_.notify_all();
+
+  captureThread_.join();
   thread_.join();
+  visualizer_.Stop();
+  if (recorder_) {
+    recorder_->Stop();
+  }
 }
 
 bool GlyphDetector::GetGlyphs(vector<Glyph>* glyphs)
@@ -48,36 +101,340 @@ bool GlyphDetector::GetGlyphs(vector<Glyph>* glyphs)
   return true;
 }
 
-void GlyphDetector::Worker(GlyphDetector* instance)
+bool GlyphDetector::WaitForGlyphs(const int timeoutMs, long* sequence,
+                                  vector<Glyph>* glyphs,
+                                  Clock::time_point* captured)
+{
+  unique_lock<mutex> lock(mutex_);
+  if (!WaitForResult(timeoutMs, sequence, &lock)) {
+    return false;
+  }
+
+  *glyphs = glyphs_;
+  *captured = glyphsCaptured_;
+
+  return true;
+}
+
+bool GlyphDetector::WaitForEvents(const int timeoutMs, long* sequence,
+                                  vector<GlyphEvent>* events, bool* resync)
+{
+  {
+    unique_lock<mutex> lock(mutex_);
+    if (!WaitForResult(timeoutMs, sequence, &lock)) {
+      return false;
+    }
+  }
+
+  events->clear();
+  *resync = eventsOverflowed_.load();
+  if (!*resync) {
+    GlyphEvent event;
+    while (events_.TryPop(&event)) {
+      events->push_back(event);
+    }
+    return true;
+  }
+
+  // The worker pushes nothing while overflowed, so what is left in the
+  // queue is older than the snapshot.
+  lock_guard<mutex> lock(mutex_);
+  GlyphEvent event;
+  while (events_.TryPop(&event)) {
+  }
+  tracker_.Snapshot(glyphsCaptured_, events);
+  eventsOverflowed_ = false;
+
+  return true;
+}
+
+bool GlyphDetector::WaitForResult(const int timeoutMs, long* sequence,
+                                  unique_lock<mutex>* lock)
 {
-  BlobDetector blobDetector;
-  Mat frame, gray;
+  const Clock::time_point deadline =
+      Clock::now() + chrono::milliseconds(max(timeoutMs, 0));
+  while (sequence_ == *sequence) {
+    if (glyphsReady_.wait_until(*lock, deadline) == cv_status::timeout) {
+      break;
+    }
+  }
 
+  if (sequence_ == *sequence) {
+    return false;
+  }
+
+  *sequence = sequence_;
+  return true;
+}
+
+DetectorStats GlyphDetector::GetStats()
+{
+  DetectorStats stats;
+  {
+    lock_guard<mutex> lock(mutex_);
+    stats = stats_;
+  }
+
+  lock_guard<mutex> lock(frameMutex_);
+  stats.framesCaptured = framesCaptured_;
+  stats.framesDropped = framesDropped_;
+
+  return stats;
+}
+
+void GlyphDetector::SetRegions(const vector<vector<Point2f>>& regions)
+{
+  lock_guard<mutex> lock(mutex_);
+  regions_ = regions;
+}
+
+void GlyphDetector::Capture(GlyphDetector* instance)
+{
   while (!instance->quit_) {
-    instance->videoCapture_ >> frame;
+    // A fresh Mat every time; the previous buffer may still be in the slot.
+    Mat frame;
+    if (!instance->ReadFrame(&frame)) {
+      continue;
+    }
+    const Clock::time_point timestamp = Clock::now();
+
+    {
+      lock_guard<mutex> lock(instance->frameMutex_);
+      if (instance->hasFrame_) {
+        ++instance->framesDropped_;
+      }
+      ++instance->framesCaptured_;
+
+      instance->latestFrame_ = frame;
+      instance->latestTimestamp_ = timestamp;
+      instance->hasFrame_ = true;
+    }
+    instance->frameReady_.notify_one();
+  }
+}
+
+bool GlyphDetector::ReadFrame(Mat* frame)
+{
+  if (!fileSource_) {
+    videoCapture_ >> *frame;
+    return !frame->empty();
+  }
+
+  // Files are replayed in a loop at the rate of a camera.
+  const double fps = Configuration::Instance().ReadDouble("input_file_fps");
+  this_thread::sleep_until(nextFileFrame_);
+  nextFileFrame_ = max(nextFileFrame_, Clock::now()) +
+      chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / fps));
+
+  if (!fileSource_->Next(frame)) {
+    fileSource_->Rewind();
+    return false;
+  }
+  return true;
+}
+
+bool GlyphDetector::WaitForFrame(Mat* frame, Clock::time_point* timestamp)
+{
+  unique_lock<mutex> lock(frameMutex_);
+  while (!hasFrame_ && !quit_) {
+    frameReady_.wait(lock);
+  }
+
+  if (quit_) {
+    return false;
+  }
+
+  *frame = latestFrame_;
+  *timestamp = latestTimestamp_;
+  latestFrame_ = Mat();
+  hasFrame_ = false;
+
+  return true;
+}
+
+void GlyphDetector::UpdateDegradation(const double latencyMs)
+{
+  const double deadlineMs =
+      Configuration::Instance().ReadDouble("frame_deadline_ms");
+  const double headroomRatio =
+      Configuration::Instance().ReadDouble("degradation_headroom_ratio");
+
+  lock_guard<mutex> lock(mutex_);
+  ++stats_.framesProcessed;
+  stats_.latencyMs = latencyMs;
+
+  int& level = stats_.degradationLevel;
+  if (latencyMs > deadlineMs) {
+    ++stats_.deadlineMisses;
+    headroomStreak_ = 0;
+    if (++missStreak_ >= MISSES_TO_DEGRADE && level < LowResolution) {
+      ++level;
+      missStreak_ = 0;
+    }
+  } else {
+    missStreak_ = 0;
+    if (latencyMs > deadlineMs * headroomRatio) {
+      headroomStreak_ = 0;
+    } else if (++headroomStreak_ >= FRAMES_TO_RESTORE && level > FullQuality) {
+      --level;
+      headroomStreak_ = 0;
+    }
+  }
+}
+
+void GlyphDetector::PublishGlyphs(const vector<Glyph>& glyphs,
+                                  const Clock::time_point captured)
+{
+  {
+    lock_guard<mutex> lock(mutex_);
+    glyphs_ = glyphs;
+    glyphsCaptured_ = captured;
+    ++sequence_;
 
-    const float factor =
+    frameEvents_.clear();
+    tracker_.Update(glyphs, captured, &frameEvents_);
+    if (!eventsOverflowed_) {
+      for (auto& event : frameEvents_) {
+        if (!events_.TryPush(event)) {
+          eventsOverflowed_ = true;
+          ++stats_.eventOverflows;
+          break;
+        }
+      }
+    }
+  }
+  glyphsReady_.notify_all();
+}
+
+void GlyphDetector::Worker(GlyphDetector* instance)
+{
+  ActivityGovernor governor;
+  Mat frame;
+  Clock::time_point timestamp;
+  vector<Glyph> glyphs;
+  FrameProcessor::Regions regions;
+  vector<Point2f> candidates;
+  long frameNumber = 0;
+
+  while (instance->WaitForFrame(&frame, &timestamp)) {
+    const Clock::time_point start = Clock::now();
+
+    // While the table is idle most frames are only glanced at.
+    if (!governor.ShouldProcess(frame, start)) {
+      lock_guard<mutex> lock(instance->mutex_);
+      instance->stats_.governorMode = governor.Mode();
+      instance->stats_.governorSkipped = governor.Skipped();
+      instance->stats_.governorSavedMs = governor.SavedMs();
+      continue;
+    }
+
+    // Only the worker changes the level, so it can be read without the lock.
+    const int level = instance->stats_.degradationLevel;
+    const bool debug = level < SkipDebug;
+
+    float factor =
       Configuration::Instance().ReadFloat("frame_resize_factor");
+    if (level >= LowResolution) {
+      factor *= Configuration::Instance().ReadFloat("degraded_resize_factor");
+    }
 
-    if (factor != 1.0f) {
-      resize(frame, frame, Size(frame.cols * factor, frame.rows * factor));
+    {
+      lock_guard<mutex> lock(instance->mutex_);
+      regions = instance->regions_;
     }
 
-    if(Configuration::Instance().ReadBool("display_input_frame")) {
-      namedWindow("input");
-      moveWindow("input", 0, 0);
-      imshow("input", frame);
+    // Encoded frames, from an MJPEG file or a camera in passthrough mode,
+    // are only decoded if the worker gets to them.
+    Mat gray;
+    if (!instance->processor_.Prepare(frame, factor, regions, &gray)) {
+      continue;
     }
 
-    cvtColor(frame, gray, CV_BGR2GRAY);
+    // The debug output is only collected here and drawn on the visualizer
+    // thread, which drops records it can't keep up with. With several
+    // regions it shows the blobs of the first one. Like the recorder, it
+    // gets a copy of the working frame, whose buffer the processor reuses.
+    DebugRecord record;
+    DebugRecord* debugRecord = nullptr;
+    if (debug && DebugVisualizer::Enabled()) {
+      debugRecord = &record;
+    }
+    if ((debugRecord || instance->recorder_) && gray.data != frame.data) {
+      gray = gray.clone();
+    }
+    if (debugRecord) {
+      record.input = FrameProcessor::IsEncoded(frame) ? gray : frame;
+    }
+
+    int maxCandidates = INT_MAX;
+    if (level >= CapCandidates) {
+      maxCandidates =
+          Configuration::Instance().ReadInt("degraded_max_candidates");
+    }
+
+    instance->processor_.Detect(gray, factor, regions, maxCandidates,
+                                debugRecord,
+                                instance->recorder_ ? &candidates : nullptr,
+                                &glyphs);
+
+    {
+      lock_guard<mutex> lock(instance->mutex_);
+      instance->stats_.decodeCacheHits = instance->processor_.CacheHits();
+      instance->stats_.decodeCacheMisses = instance->processor_.CacheMisses();
+      instance->stats_.prefilter = instance->processor_.GetPrefilterStats();
+      instance->stats_.recorderDropped =
+          instance->recorder_ ? instance->recorder_->Dropped() : 0;
+      instance->stats_.governorMode = governor.Mode();
+    }
+
+    if (debugRecord) {
+      instance->visualizer_.Publish(debugRecord);
+    }
+
+    instance->PublishGlyphs(glyphs, timestamp);
+
+    const Clock::time_point done = Clock::now();
+    const double latencyMs =
+        chrono::duration<double, milli>(done - timestamp).count();
+    const double processingMs =
+        chrono::duration<double, milli>(done - start).count();
+
+    // Only the worker writes the events of the frame.
+    governor.OnProcessed(instance->frameEvents_, processingMs, done);
 
-    blobDetector.Run(gray);
-    int regionCount = blobDetector.GetCandidatesCount();
-    while (regionCount-- > 0) {
-      std::vector<cv::Point2f> vertices = blobDetector.GetVertices(regionCount);
-      if (!instance->glyphValidator_.Validate(frame, vertices)) {
-        continue;
+    // Like the debug record, the frame shares the copy of gray.
+    if (instance->recorder_) {
+      SessionFrame record;
+      record.sequence = frameNumber;
+      record.capturedNs = chrono::duration_cast<chrono::nanoseconds>(
+          timestamp.time_since_epoch()).count();
+      record.processingMs = processingMs;
+      record.latencyMs = latencyMs;
+      record.resizeFactor = factor;
+      record.degradationLevel = level;
+      record.gray = gray;
+      record.candidates.swap(candidates);
+      record.regions = regions;
+      for (auto& glyph : glyphs) {
+        LoggedGlyph logged = { glyph.Id(), float(glyph.Center().x),
+                               float(glyph.Center().y), float(glyph.Angle()) };
+        record.glyphs.push_back(logged);
       }
+      instance->recorder_->Publish(&record);
+    }
+    ++frameNumber;
+
+    instance->UpdateDegradation(latencyMs);
+
+    // Detection may deliberately run slower than the camera to save CPU;
+    // the consumer extrapolates poses in between. Frames captured in the
+    // meantime are replaced by newer ones.
+    const double maxFps =
+        Configuration::Instance().ReadDouble("detection_max_fps");
+    if (maxFps > 0) {
+      this_thread::sleep_until(start +
+          chrono::duration_cast<Clock::duration>(
+              chrono::duration<double>(1.0 / maxFps)));
     }
   }
 }
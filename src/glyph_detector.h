@@ -1,30 +1,144 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <thread>
 
 #include "opencv2/opencv.hpp"
 
+#include "blob_detector.h"
+#include "debug_visualizer.h"
+#include "frame_processor.h"
 #include "glyph.h"
-#include "glyph_validator.h"
+#include "glyph_tracker.h"
+#include "jpeg_decoder.h"
+#include "session_recorder.h"
+#include "spsc_queue.h"
+
+// Quality levels the worker steps through while it keeps missing the
+// per-frame deadline. Every level keeps the savings of the previous ones.
+enum DegradationLevel
+{
+  FullQuality = 0,
+  SkipDebug,
+  CapCandidates,
+  LowResolution
+};
+
+struct DetectorStats
+{
+  long framesCaptured;
+  // Frames overwritten in the mailbox before the worker picked them up.
+  long framesDropped;
+  long framesProcessed;
+  long deadlineMisses;
+  // Capture-to-result latency of the last processed frame.
+  double latencyMs;
+  int degradationLevel;
+  // Candidates decoded from the validator cache and the ones decoded fully.
+  long decodeCacheHits;
+  long decodeCacheMisses;
+  // Blobs the BlobDetector rejected before any per-blob image work.
+  PrefilterStats prefilter;
+  // Frames the session recorder couldn't keep up with.
+  long recorderDropped;
+  // Times the event queue ran full and the consumer had to resynchronize.
+  long eventOverflows;
+  // GovernorMode of the activity governor, the frames it skipped while the
+  // table was idle and the processing time that saved, estimated.
+  int governorMode;
+  long governorSkipped;
+  double governorSavedMs;
+};
 
 class GlyphDetector
 {
  public:
+  typedef std::chrono::steady_clock Clock;
+
   GlyphDetector(std::string filename);
   ~GlyphDetector();
 
   void Stop();
   bool GetGlyphs(std::vector<Glyph>* glyphs);
+  // Sleeps for up to timeoutMs until a result newer than *sequence has been
+  // published. On success it copies the glyphs together with the capture
+  // time of the frame they were detected in and advances *sequence.
+  bool WaitForGlyphs(const int timeoutMs, long* sequence,
+                     std::vector<Glyph>* glyphs, Clock::time_point* captured);
+  // Sleeps like WaitForGlyphs, then moves the track events published since
+  // the last call into *events, oldest first. Returns false on timeout.
+  // Sets *resync when events were lost because the consumer fell behind;
+  // *events then holds a GlyphAppeared event for every live track instead,
+  // and whatever was built from earlier events has to be dropped.
+  bool WaitForEvents(const int timeoutMs, long* sequence,
+                     std::vector<GlyphEvent>* events, bool* resync);
+  DetectorStats GetStats();
+  // Restricts detection to the given polygons in the coordinates of the
+  // glyph poses, e.g. the four corners of a rectangle. Those are camera
+  // pixels, undistorted when the lens_* keys set a distortion. Only the
+  // bounding rectangles of the polygons as seen through the lens are
+  // preprocessed and searched, and candidates centered outside every
+  // polygon are dropped before validation. An empty list restores the
+  // whole frame. Takes effect from the next frame.
+  void SetRegions(const std::vector<std::vector<cv::Point2f>>& regions);
 
  private:
+  static void Capture(GlyphDetector* instance);
   static void Worker(GlyphDetector* instance);
 
+  bool ReadFrame(cv::Mat* frame);
+  bool WaitForFrame(cv::Mat* frame, Clock::time_point* timestamp);
+  bool WaitForResult(const int timeoutMs, long* sequence,
+                     std::unique_lock<std::mutex>* lock);
+  void UpdateDegradation(const double latencyMs);
+  void PublishGlyphs(const std::vector<Glyph>& glyphs,
+                     const Clock::time_point captured);
+
   cv::VideoCapture videoCapture_;
-  bool quit_;
+  // Replaces the camera when input_source names an MJPEG file.
+  std::unique_ptr<MjpegReader> fileSource_;
+  Clock::time_point nextFileFrame_;
+  // Read by the capture thread without frameMutex_.
+  std::atomic<bool> quit_;
+  std::thread captureThread_;
   std::thread thread_;
   std::mutex mutex_;
+  std::condition_variable glyphsReady_;
   std::vector<Glyph> glyphs_;
-  GlyphValidator glyphValidator_;
+  Clock::time_point glyphsCaptured_;
+  long sequence_;
+  // Tracks are updated and their events pushed while holding mutex_, the
+  // consumer pops them without it. Once a push fails nothing more is
+  // pushed until the consumer has resynchronized from a snapshot.
+  GlyphTracker tracker_;
+  std::vector<GlyphEvent> frameEvents_;
+  SpscQueue<GlyphEvent> events_;
+  std::atomic<bool> eventsOverflowed_;
+  // Set by the consumer, guarded by mutex_.
+  std::vector<std::vector<cv::Point2f>> regions_;
+  FrameProcessor processor_;
+  DebugVisualizer visualizer_;
+  // Only there when recorder_enabled is set.
+  std::unique_ptr<SessionRecorder> recorder_;
+
+  // Single slot holding the newest captured frame. The capture thread
+  // overwrites it, so the worker always starts on the freshest frame.
+  std::mutex frameMutex_;
+  std::condition_variable frameReady_;
+  cv::Mat latestFrame_;
+  Clock::time_point latestTimestamp_;
+  bool hasFrame_;
+  // Counted by the capture thread under frameMutex_, and merged into the
+  // rest of the stats, which mutex_ guards, by GetStats.
+  long framesCaptured_;
+  long framesDropped_;
+
+  DetectorStats stats_;
+  int missStreak_;
+  int headroomStreak_;
 };
 
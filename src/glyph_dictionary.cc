@@ -0,0 +1,262 @@
+#include "glyph_dictionary.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include "glyph.h"
+
+static const char MAGIC[8] = { 'G', 'L', 'Y', 'P', 'H', 'D', 'I', 'C' };
+static const uint32_t VERSION = 1;
+// Grid sizes that have a specialized sampler in GlyphValidator.
+static const size_t MIN_GRID_SIZE = 3;
+static const size_t MAX_GRID_SIZE = 7;
+
+static size_t Align(size_t offset)
+{
+  return (offset + 7) & ~size_t(7);
+}
+
+static bool EntryLess(const DictionaryEntry& a, const DictionaryEntry& b)
+{
+  if (a.size != b.size)
+    return a.size < b.size;
+  return a.code < b.code;
+}
+
+GlyphDictionary::GlyphDictionary(const std::string& filename)
+  : mapping_(nullptr), mappingLength_(0), header_(nullptr), glyphs_(nullptr),
+    entries_(nullptr), names_(nullptr)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw "Couldn't open the glyph dictionary";
+  }
+
+  struct stat st;
+  char magic[sizeof(MAGIC)];
+  bool compiled = fstat(fd, &st) == 0 &&
+      size_t(st.st_size) >= sizeof(DictionaryHeader) &&
+      read(fd, magic, sizeof(magic)) == ssize_t(sizeof(magic)) &&
+      memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+
+  if (compiled)
+  {
+    mappingLength_ = st.st_size;
+    mapping_ = mmap(nullptr, mappingLength_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping_ == MAP_FAILED)
+    {
+      mapping_ = nullptr;
+      throw "Couldn't map the glyph dictionary";
+    }
+    Attach(static_cast<const char*>(mapping_), mappingLength_);
+  }
+  else
+  {
+    close(fd);
+    compiled_ = Compile(filename);
+    Attach(compiled_.data(), compiled_.size());
+  }
+
+  std::cout << "Read " << Count() << " glyphs from " << filename << std::endl;
+}
+
+GlyphDictionary::~GlyphDictionary()
+{
+  if (mapping_)
+  {
+    munmap(mapping_, mappingLength_);
+  }
+}
+
+std::vector<char> GlyphDictionary::Compile(const std::string& filename)
+{
+  std::ifstream ifile(filename.c_str());
+  if (!ifile)
+  {
+    throw "Couldn't open the glyph dictionary";
+  }
+
+  std::vector<DictionaryGlyph> glyphs;
+  std::vector<DictionaryEntry> entries;
+  std::string names;
+  std::map<std::string, uint32_t> interned;
+  uint32_t size_mask = 0;
+
+  for (std::string line; getline(ifile, line); )
+  {
+    size_t idx = line.find_first_of("=");
+    if (idx == std::string::npos)
+      continue;
+    std::string glyph_name = line.substr(0, idx);
+    std::string glyph_schema = line.substr(idx + 1);
+    Glyph glyph(glyph_schema);
+    size_t size = glyph.Size();
+    if (size < MIN_GRID_SIZE || size > MAX_GRID_SIZE ||
+        size * size != glyph_schema.size())
+    {
+      std::cout << "Skipping " << glyph_name << ", unsupported schema"
+                << std::endl;
+      continue;
+    }
+
+    std::map<std::string, uint32_t>::iterator name =
+        interned.find(glyph_name);
+    if (name == interned.end())
+    {
+      name = interned.insert(
+          std::make_pair(glyph_name, uint32_t(names.size()))).first;
+      names.append(glyph_name);
+      names.push_back('\0');
+    }
+
+    DictionaryGlyph record;
+    record.code = glyph.Code();
+    record.nameOffset = name->second;
+    record.size = size;
+    for (int turns = 0; turns < 4; ++turns)
+    {
+      DictionaryEntry entry;
+      entry.code = glyph.Rotated(turns).Code();
+      entry.glyph = glyphs.size();
+      entry.size = size;
+      entry.quarterTurns = turns;
+      entries.push_back(entry);
+    }
+    glyphs.push_back(record);
+    size_mask |= 1u << size;
+  }
+
+  // Symmetric glyphs read the same in several orientations and different
+  // glyphs may collide; the first glyph and the fewest turns win.
+  std::stable_sort(entries.begin(), entries.end(), EntryLess);
+  entries.erase(std::unique(entries.begin(), entries.end(),
+                            [](const DictionaryEntry& a,
+                               const DictionaryEntry& b) {
+                              return a.size == b.size && a.code == b.code;
+                            }),
+                entries.end());
+
+  DictionaryHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.sizeMask = size_mask;
+  header.glyphCount = glyphs.size();
+  header.entryCount = entries.size();
+  header.namesSize = names.size();
+  header.glyphsOffset = Align(sizeof(header));
+  header.entriesOffset =
+      Align(header.glyphsOffset + glyphs.size() * sizeof(DictionaryGlyph));
+  header.namesOffset =
+      Align(header.entriesOffset + entries.size() * sizeof(DictionaryEntry));
+
+  std::vector<char> data(header.namesOffset + names.size());
+  memcpy(&data[0], &header, sizeof(header));
+  if (!glyphs.empty())
+  {
+    memcpy(&data[header.glyphsOffset], glyphs.data(),
+           glyphs.size() * sizeof(DictionaryGlyph));
+    memcpy(&data[header.entriesOffset], entries.data(),
+           entries.size() * sizeof(DictionaryEntry));
+    memcpy(&data[header.namesOffset], names.data(), names.size());
+  }
+  return data;
+}
+
+void GlyphDictionary::Attach(const char* data, size_t length)
+{
+  if (length < sizeof(DictionaryHeader))
+  {
+    throw "Truncated glyph dictionary";
+  }
+  header_ = reinterpret_cast<const DictionaryHeader*>(data);
+  if (header_->version != VERSION)
+  {
+    throw "Unsupported glyph dictionary version";
+  }
+  const uint64_t glyphsEnd = header_->glyphsOffset +
+      uint64_t(header_->glyphCount) * sizeof(DictionaryGlyph);
+  const uint64_t entriesEnd = header_->entriesOffset +
+      uint64_t(header_->entryCount) * sizeof(DictionaryEntry);
+  const uint64_t namesEnd = header_->namesOffset + header_->namesSize;
+  if (glyphsEnd > length || entriesEnd > length || namesEnd > length ||
+      (header_->namesSize > 0 && data[namesEnd - 1] != '\0'))
+  {
+    throw "Truncated glyph dictionary";
+  }
+
+  glyphs_ =
+      reinterpret_cast<const DictionaryGlyph*>(data + header_->glyphsOffset);
+  entries_ =
+      reinterpret_cast<const DictionaryEntry*>(data + header_->entriesOffset);
+  names_ = data + header_->namesOffset;
+
+  for (size_t i = 0; i < header_->glyphCount; ++i)
+  {
+    if (glyphs_[i].nameOffset >= header_->namesSize)
+    {
+      throw "Corrupt glyph dictionary";
+    }
+  }
+  // Find hands out entry glyphs as ids that index glyphs_.
+  for (size_t i = 0; i < header_->entryCount; ++i)
+  {
+    if (entries_[i].glyph >= header_->glyphCount)
+    {
+      throw "Corrupt glyph dictionary";
+    }
+  }
+}
+
+size_t GlyphDictionary::Count() const
+{
+  return header_->glyphCount;
+}
+
+uint32_t GlyphDictionary::SizeMask() const
+{
+  return header_->sizeMask;
+}
+
+bool GlyphDictionary::Find(int size, uint64_t code, int* id,
+                           int* quarter_turns) const
+{
+  DictionaryEntry key;
+  key.code = code;
+  key.size = size;
+  const DictionaryEntry* end = entries_ + header_->entryCount;
+  const DictionaryEntry* entry =
+      std::lower_bound(entries_, end, key, EntryLess);
+  if (entry == end || entry->size != key.size || entry->code != code)
+  {
+    return false;
+  }
+  *id = entry->glyph;
+  *quarter_turns = entry->quarterTurns;
+  return true;
+}
+
+uint64_t GlyphDictionary::Code(int id) const
+{
+  return glyphs_[id].code;
+}
+
+int GlyphDictionary::Size(int id) const
+{
+  return glyphs_[id].size;
+}
+
+const char* GlyphDictionary::Name(int id) const
+{
+  return names_ + glyphs_[id].nameOffset;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk layout of a compiled dictionary, see tools/dictionary_compiler.cc.
+// All integers are in host byte order and every section starts 8-byte
+// aligned, so a mapped file is used in place.
+//
+//    DictionaryHeader
+//    DictionaryGlyph[glyphCount]    in dictionary order, index is the id
+//    DictionaryEntry[entryCount]    sorted by size, then code
+//    char[namesSize]                NUL-terminated names, duplicates shared
+struct DictionaryHeader
+{
+  char magic[8];
+  uint32_t version;
+  // Bit s is set when the dictionary has glyphs of s x s cells.
+  uint32_t sizeMask;
+  uint32_t glyphCount;
+  uint32_t entryCount;
+  uint32_t namesSize;
+  uint32_t reserved;
+  uint64_t glyphsOffset;
+  uint64_t entriesOffset;
+  uint64_t namesOffset;
+};
+
+struct DictionaryGlyph
+{
+  // Cells of the glyph as it is written in the dictionary, see Glyph::Code.
+  uint64_t code;
+  uint32_t nameOffset;
+  uint32_t size;
+};
+
+// A code the glyph reads as when it is turned clockwise by quarterTurns.
+struct DictionaryEntry
+{
+  uint64_t code;
+  uint32_t glyph;
+  uint16_t size;
+  uint16_t quarterTurns;
+};
+
+// Glyph dictionary either mapped from a compiled file, so that processes
+// share it through the page cache, or compiled in memory from the text
+// format. Lookups only touch the flat tables in both cases.
+class GlyphDictionary
+{
+ public:
+  // Compiled files are recognized by their magic, anything else is read as
+  // a text dictionary.
+  GlyphDictionary(const std::string& filename);
+  ~GlyphDictionary();
+
+  // Compiles a text dictionary with lines of the form
+  //
+  //    glyph_name=glyph_schema
+  //
+  // into the compiled layout. Glyphs are numbered in the order they appear
+  // in the file; schemas that are not square or not 3x3 to 7x7 are
+  // skipped.
+  static std::vector<char> Compile(const std::string& filename);
+
+  size_t Count() const;
+  uint32_t SizeMask() const;
+
+  // Finds the glyph that reads as code on a grid of size x size cells.
+  bool Find(int size, uint64_t code, int* id, int* quarter_turns) const;
+
+  uint64_t Code(int id) const;
+  int Size(int id) const;
+  const char* Name(int id) const;
+
+ private:
+  GlyphDictionary(const GlyphDictionary&);
+  GlyphDictionary& operator=(const GlyphDictionary&);
+
+  // Points the tables into data and checks that they fit.
+  void Attach(const char* data, size_t length);
+
+  void* mapping_;
+  size_t mappingLength_;
+  // Backs the tables of a text dictionary.
+  std::vector<char> compiled_;
+
+  const DictionaryHeader* header_;
+  const DictionaryGlyph* glyphs_;
+  const DictionaryEntry* entries_;
+  const char* names_;
+};
@@ -0,0 +1,124 @@
+#include "glyph_tracker.h"
+
+#include <cmath>
+
+#include "configuration.h"
+
+using namespace cv;
+using namespace std;
+
+GlyphTracker::GlyphTracker()
+    : nextTrack_(0)
+{
+}
+
+GlyphTracker::~GlyphTracker()
+{
+}
+
+void GlyphTracker::Update(const vector<Glyph>& glyphs,
+                          const Clock::time_point captured,
+                          vector<GlyphEvent>* events)
+{
+  Configuration& config = Configuration::Instance();
+  const double matchDistance = config.ReadDouble("track_match_distance");
+  const int lostFrames = config.ReadInt("track_lost_frames");
+  const double moveThreshold = config.ReadDouble("event_move_threshold");
+  const double rotateThreshold = config.ReadDouble("event_rotate_threshold");
+
+  for (auto& track : tracks_) {
+    track.matched = false;
+  }
+
+  for (auto& glyph : glyphs) {
+    if (glyph.Id() < 0) {
+      continue;
+    }
+
+    // Greedy: the nearest track of the same glyph not taken yet.
+    Track* match = nullptr;
+    double best = matchDistance;
+    for (auto& track : tracks_) {
+      if (track.matched || track.reported.glyph != glyph.Id()) {
+        continue;
+      }
+      const double distance = norm(glyph.Center() - track.center);
+      if (distance <= best) {
+        best = distance;
+        match = &track;
+      }
+    }
+
+    GlyphEvent event;
+    event.track = match ? match->reported.track : nextTrack_++;
+    event.glyph = glyph.Id();
+    event.x = glyph.Center().x;
+    event.y = glyph.Center().y;
+    event.angle = glyph.Angle();
+    event.captured = captured;
+
+    if (!match) {
+      event.type = GlyphAppeared;
+      Track track;
+      track.reported = event;
+      track.center = glyph.Center();
+      track.missed = 0;
+      track.moving = false;
+      track.matched = true;
+      tracks_.push_back(track);
+      events->push_back(event);
+      continue;
+    }
+
+    match->matched = true;
+    match->missed = 0;
+    match->center = glyph.Center();
+
+    // Compared to what was reported rather than to the previous frame, so
+    // that slow motion still adds up to an event.
+    const bool moved = hypot(event.x - match->reported.x,
+                             event.y - match->reported.y) > moveThreshold;
+    const bool rotated = fabs(remainder(event.angle - match->reported.angle,
+                                        360.0f)) > rotateThreshold;
+    if (moved) {
+      event.type = GlyphMoved;
+    } else if (rotated) {
+      event.type = GlyphRotated;
+    } else if (match->moving) {
+      event.type = GlyphStopped;
+    } else {
+      continue;
+    }
+
+    match->moving = moved || rotated;
+    match->reported = event;
+    events->push_back(event);
+  }
+
+  // Glyphs missing from a frame or two, e.g. in motion blur, keep their
+  // track.
+  for (auto it = tracks_.begin(); it != tracks_.end(); ) {
+    if (it->matched || ++it->missed < lostFrames) {
+      ++it;
+      continue;
+    }
+
+    GlyphEvent event = it->reported;
+    event.type = GlyphLost;
+    event.captured = captured;
+    events->push_back(event);
+    it = tracks_.erase(it);
+  }
+}
+
+void GlyphTracker::Snapshot(const Clock::time_point captured,
+                            vector<GlyphEvent>* events) const
+{
+  events->clear();
+  for (auto& track : tracks_) {
+    GlyphEvent event = track.reported;
+    event.type = GlyphAppeared;
+    event.captured = captured;
+    events->push_back(event);
+  }
+}
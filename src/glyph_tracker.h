@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "glyph.h"
+
+enum GlyphEventType
+{
+  // A glyph that wasn't tracked yet; also used for every track on resync.
+  GlyphAppeared = 0,
+  // The center moved further than event_move_threshold since last reported.
+  GlyphMoved,
+  // The angle turned further than event_rotate_threshold, the center didn't.
+  GlyphRotated,
+  // A track that moved or rotated in the previous frame stayed within the
+  // thresholds. It carries the pose the glyph came to rest at.
+  GlyphStopped,
+  // Not seen for track_lost_frames frames in a row.
+  GlyphLost
+};
+
+// A change of one track. Every event but GlyphLost carries the current pose,
+// in camera coordinates.
+struct GlyphEvent
+{
+  typedef std::chrono::steady_clock Clock;
+
+  GlyphEventType type;
+  // Stable over frames; different for two glyphs with the same dictionary id.
+  int track;
+  // Dictionary id of the glyph.
+  int glyph;
+  float x;
+  float y;
+  float angle;
+  // Capture time of the frame the change was seen in.
+  Clock::time_point captured;
+};
+
+// Assigns stable track ids to the glyphs detected frame after frame, by
+// dictionary id and nearest center, and reports only what changed. Glyphs
+// that stay where they are produce no events at all.
+class GlyphTracker
+{
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  GlyphTracker();
+  ~GlyphTracker();
+
+  // Matches the glyphs of a frame to the tracks and appends the resulting
+  // events to *events.
+  void Update(const std::vector<Glyph>& glyphs,
+              const Clock::time_point captured,
+              std::vector<GlyphEvent>* events);
+  // Replaces *events with a GlyphAppeared event for every live track, at
+  // the pose last reported for it. The events carry the capture time of the
+  // latest frame rather than that of the last report, which for a glyph
+  // lying still may be long ago: the pose is as current as that frame.
+  void Snapshot(const Clock::time_point captured,
+                std::vector<GlyphEvent>* events) const;
+
+ private:
+  struct Track
+  {
+    // What the consumer was last told about the track.
+    GlyphEvent reported;
+    // Last measured center, which the next frame is matched against.
+    cv::Point2d center;
+    int missed;
+    bool moving;
+    bool matched;
+  };
+
+  std::vector<Track> tracks_;
+  int nextTrack_;
+};
@@ -1,88 +1,160 @@
-#include <fstream>
 #include <vector>
 
 #include "glyph_validator.h"
 
 #include "opencv2/opencv.hpp"
 
+#include "configuration.h"
+#include "grid_sampler.h"
+
 using namespace std;
 
-// Specifies the width and height of the model coordinate space,
-// to which glyph will be mapped to identify its schema.
-static const size_t MODEL_SIZE = 100;
-static const size_t GLYPH_SIZE = 5;
+// Width and height of the sampled cells in the debug output, so that cells
+// of different grid sizes can be shown side by side.
+static const int CELL_MAP_SIZE = 100;
 
 GlyphValidator::GlyphValidator(std::string filename)
+  : dictionary_(filename),
+    cache_(Configuration::Instance().ReadInt("decode_cache_size"),
+           Configuration::Instance().ReadFloat("decode_cache_epsilon"),
+           Configuration::Instance().ReadInt("decode_cache_signature_tolerance"))
 {
-  // Expects a file with the following format
-  //
-  //    glyph_name=glyph_schema
-  //
-  //  schema is specified as a sequence of b/w chars
-  //  b represents that a particular cell is black
-  //  w represents that a particular cell is white
-  //
-  // It always starts at the top-left corner of the glyph.
-  std::ifstream ifile(filename.c_str());
-  for (std::string line; getline(ifile, line); )
-  {
-    int idx = line.find_first_of("=");
-    std::string glyph_name = line.substr(0, idx);
-    std::string glyph_schema = line.substr(idx + 1, line.size());
-    glyphs_[glyph_name] = new Glyph(glyph_schema);
-    std::cout << "Read " << glyph_name << std::endl;
-  }
 }
 
 GlyphValidator::~GlyphValidator()
 {
-  std::map<std::string, Glyph*>::iterator it = glyphs_.begin();
-  while (it != glyphs_.end())
-  {
-    delete it->second;
-  }
-  glyphs_.clear();
 }
 
-bool GlyphValidator::Validate(cv::Mat image, const vector<cv::Point2f>& detectedPts)
+bool GlyphValidator::Validate(cv::Mat image, const vector<cv::Point2f>& detectedPts,
+                              DebugRecord* debug, Glyph* glyph)
 {
   if (detectedPts.size() != 4 || !AreValidPoints(image, detectedPts))
   {
-    // TODO: raise an exception.
     return false;
   }
 
-  vector<cv::Point2f> modelPts;
-  modelPts.push_back(cv::Point2f(0.0f, 0.0f));
-  modelPts.push_back(cv::Point2f(MODEL_SIZE, 0.0f));
-  modelPts.push_back(cv::Point2f(MODEL_SIZE, MODEL_SIZE));
-  modelPts.push_back(cv::Point2f(0.0f, MODEL_SIZE));
-
+  lens_.Update();
   vector<cv::Point2f> reorderPts = ReorderPoints(detectedPts);
-  cv::Mat H = cv::findHomography(modelPts, reorderPts);
 
-  cv::Mat mapImg(cv::Size(MODEL_SIZE, MODEL_SIZE), CV_8UC1);
+  // Through a distorting lens the glyph is only a perspective square, and
+  // its pose only right, in undistorted coordinates. Just the corners are
+  // corrected here, and the cell samples while decoding.
+  vector<cv::Point2f> correctedPts = reorderPts;
+  if (lens_.Enabled())
+  {
+    const float scale = lens_.Scale(image.cols);
+    for (size_t i = 0; i < correctedPts.size(); ++i)
+    {
+      correctedPts[i] = lens_.Undistort(correctedPts[i], scale);
+    }
+  }
 
-  string glyph_schema;
-  for (size_t r = 0; r < GLYPH_SIZE; ++r)
+  // A glyph that barely moved since it was last decoded is taken from the
+  // cache, skipping the homography and the resampling of every cell.
+  int quarter_turns = 0;
+  if (!cache_.Find(image, reorderPts, glyph, &quarter_turns))
   {
-    for (size_t c = 0; c < GLYPH_SIZE; ++c)
+    if (!Decode(image, correctedPts, debug, glyph, &quarter_turns))
     {
-      char color = IdentifyCellColor(image, H, r, c, &mapImg);
-      if (color == 'b' || color == 'w')
-      {
-        glyph_schema.push_back(color);
-      }
-      else
+      return false;
+    }
+    cache_.Insert(image, reorderPts, *glyph, quarter_turns);
+  }
+
+  // Rotate the corners so the first one is the glyph's own top-left corner.
+  vector<cv::Point2f> corners;
+  for (size_t i = 0; i < reorderPts.size(); ++i)
+  {
+    corners.push_back(correctedPts[(i + quarter_turns) % correctedPts.size()]);
+  }
+
+  glyph->SetPose(corners);
+  return true;
+}
+
+long GlyphValidator::CacheHits() const
+{
+  return cache_.Hits();
+}
+
+long GlyphValidator::CacheMisses() const
+{
+  return cache_.Misses();
+}
+
+const LensModel& GlyphValidator::Lens()
+{
+  lens_.Update();
+  return lens_;
+}
+
+bool GlyphValidator::Decode(cv::Mat image, const vector<cv::Point2f>& reorderPts,
+                           DebugRecord* debug, Glyph* glyph, int* quarter_turns)
+{
+  const cv::Point2f modelPts[] = {
+    cv::Point2f(0.0f, 0.0f), cv::Point2f(1.0f, 0.0f),
+    cv::Point2f(1.0f, 1.0f), cv::Point2f(0.0f, 1.0f)
+  };
+  const cv::Point2f imagePts[] = {
+    reorderPts[0], reorderPts[1], reorderPts[2], reorderPts[3]
+  };
+  const cv::Mat H = cv::getPerspectiveTransform(modelPts, imagePts);
+  const double* h = H.ptr<double>();
+
+  for (int size = 0; size < 32; ++size)
+  {
+    if (!(dictionary_.SizeMask() & (1u << size)))
+    {
+      continue;
+    }
+
+    // The sampled cells are only kept for the debug output.
+    cv::Mat cells;
+    uint64_t code = 0;
+    if (!SampleCells(size, image, h, lens_.Enabled() ? &lens_ : nullptr,
+                     &code, debug ? &cells : nullptr))
+    {
+      continue;
+    }
+
+    if (debug)
+    {
+      string glyph_schema;
+      for (int i = 0; i < size * size; ++i)
       {
-        return false;
+        glyph_schema.push_back((code >> i) & 1 ? 'b' : 'w');
       }
+      cv::Mat mapImg;
+      cv::resize(cells, mapImg, cv::Size(CELL_MAP_SIZE, CELL_MAP_SIZE), 0, 0,
+                 cv::INTER_NEAREST);
+      debug->cellMaps.push_back(mapImg);
+      debug->schemas.push_back(glyph_schema);
+    }
+
+    int id = 0;
+    if (dictionary_.Find(size, code, &id, quarter_turns))
+    {
+      *glyph = Glyph(size, dictionary_.Code(id));
+      glyph->SetId(id);
+      return true;
     }
   }
+  return false;
+}
 
-  cv::imshow("debug", mapImg);
-  cout << "Schema is " << glyph_schema << endl;
-  return true;
+bool GlyphValidator::SampleCells(int size, const cv::Mat& image, const double* h,
+                                 const LensModel* lens, uint64_t* code,
+                                 cv::Mat* cells)
+{
+  switch (size)
+  {
+    case 3: return GridSampler<3>::Sample(image, h, lens, code, cells);
+    case 4: return GridSampler<4>::Sample(image, h, lens, code, cells);
+    case 5: return GridSampler<5>::Sample(image, h, lens, code, cells);
+    case 6: return GridSampler<6>::Sample(image, h, lens, code, cells);
+    case 7: return GridSampler<7>::Sample(image, h, lens, code, cells);
+    default: return false;
+  }
 }
 
 bool GlyphValidator::AreValidPoints(cv::Mat image, const vector<cv::Point2f>& detectedPts)
@@ -158,73 +230,3 @@ vector<cv::Point2f> GlyphValidator::ReorderPoints(const vector<cv::Point2f>& det
   reorderedPts.push_back(bottom_left);
   return reorderedPts;
 }
-
-std::string GlyphValidator::GetGlyphName(const Glyph& glyph)
-{
-  std::map<std::string, Glyph*>::iterator it = glyphs_.begin();
-  while (it != glyphs_.end())
-  {
-    if (*it->second == glyph)
-      return it->first;
-  }
-  // TODO: throw an exception, maybe?
-  return "";
-}
-
-char GlyphValidator::IdentifyCellColor(cv::Mat image, cv::Mat H, size_t r, size_t c, cv::Mat* map_image)
-{
-  // Unless a cell is overwhelmingly of a particular color, we should not 
-  // classify it to be one. This variable defines when a cell is 'overwhelmingly' 
-  // of a particular color.
-  float count_threshold = 0.8f;
-  uint8_t color_threshold = 128;
-  size_t cell_size = MODEL_SIZE / GLYPH_SIZE;
-  int b_counter = 0, w_counter = 0;
-  uint8_t* pixel_buf = image.ptr<uint8_t>();
-  for (size_t y = 0; y < cell_size; ++y)
-  {
-    for (size_t x = 0; x < cell_size; ++x)
-    {
-      cv::Point3f model_pt(c * cell_size + x, r * cell_size + y, 1);
-      cv::Point3f dest_pt = Transform(model_pt, H);
-      uint8_t pixel_color = image.at<uint8_t>(int(dest_pt.y / dest_pt.z), int(dest_pt.x / dest_pt.z));
-      if (pixel_color < color_threshold)
-      {
-        ++b_counter;
-      }
-      else
-      {
-        ++w_counter;
-      }
-      if (map_image)
-      {
-        map_image->at<uint8_t>(model_pt.y, model_pt.x) = pixel_color;
-      }
-    }
-  }
-  // Ratio of number of black colored pixels should be greater than the
-  // threshold defined by count_threshold for it be considered a black
-  // cell. Vice versa for white cell.
-  float b_ratio = b_counter / float(b_counter + w_counter);
-  return (b_ratio >= count_threshold) ? 'b' 
-    : (b_ratio <= (1 - count_threshold) ? 'w' : 'u');
-}
-
-cv::Point3f GlyphValidator::Transform(cv::Point3f& pt, cv::Mat H)
-{
-  vector<cv::Point3f> src_pts;
-  src_pts.push_back(pt);
-  vector<cv::Point3f> dest_pts;
-  dest_pts.push_back(cv::Point3f(0, 0, 1));
-  cv::perspectiveTransform(src_pts, dest_pts, H);
-  return dest_pts[0];
-}
-
-void PrintPoints(vector<cv::Point2f> pts)
-{
-  cout << "Following points are in the list:" << endl;
-  for (size_t i = 0; i < pts.size(); ++i)
-  {
-    cout << pts[i].x << ", " << pts[i].y << endl;
-  }
-}
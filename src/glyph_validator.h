@@ -1,30 +1,56 @@
 #pragma once
 
-#include <map>
 #include <string>
 #include <vector>
 
 #include "opencv2/opencv.hpp"
 
+#include "debug_record.h"
+#include "decode_cache.h"
 #include "glyph.h"
+#include "glyph_dictionary.h"
+#include "lens_model.h"
 
 class GlyphValidator
 {
   public:
+    // Takes a text dictionary or one compiled by tools/dictionary_compiler.
     GlyphValidator(std::string filename);
     ~GlyphValidator();
 
-    bool Validate(cv::Mat image, const std::vector<cv::Point2f>& detectedPts);
+    // Decodes the glyph inside the quad of a grayscale image. On success the
+    // glyph carries its dictionary id and pose in image coordinates. When a
+    // debug record is given, the sampled cells are added to it.
+    bool Validate(cv::Mat image, const std::vector<cv::Point2f>& detectedPts,
+                  DebugRecord* debug, Glyph* glyph);
+
+    long CacheHits() const;
+    long CacheMisses() const;
+    // Up to date with the configuration.
+    const LensModel& Lens();
 
   private:
-    std::map<std::string, Glyph*> glyphs_;
+    // Benchmarks measure the private stages one by one.
+    friend class StageBenchmark;
+
+    GlyphDictionary dictionary_;
+    DecodeCache cache_;
+    LensModel lens_;
 
     bool AreValidPoints(cv::Mat image, const std::vector<cv::Point2f>& detectedPts);
     // Reorders points such that points start from top-left and then ordered
     // clockwise.
     std::vector<cv::Point2f> ReorderPoints(const std::vector<cv::Point2f>& detectedPts);
-    std::string GetGlyphName(const Glyph& glyph);
-    char IdentifyCellColor(cv::Mat image, cv::Mat H, size_t r, size_t c, cv::Mat* map_image);
-    cv::Point3f Transform(cv::Point3f& pt, cv::Mat H);
+    // Samples the cells of the quad for every payload size in the
+    // dictionary, cheapest first, and looks the codes up. On success sets
+    // the dictionary glyph and how many clockwise quarter turns it is
+    // rotated by in the image.
+    bool Decode(cv::Mat image, const std::vector<cv::Point2f>& reorderPts,
+                DebugRecord* debug, Glyph* glyph, int* quarter_turns);
+    // Dispatches to the GridSampler specialized for the payload size. Returns
+    // false for sizes without a sampler.
+    static bool SampleCells(int size, const cv::Mat& image, const double* h,
+                            const LensModel* lens, uint64_t* code,
+                            cv::Mat* cells);
 };
 
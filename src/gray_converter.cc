@@ -0,0 +1,139 @@
+#include "gray_converter.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+// Fixed point luma weights of cv::cvtColor for BGR to gray, in 1/2^14.
+static const int WEIGHT_SHIFT = 14;
+static const int BLUE_WEIGHT = 1868;
+static const int GREEN_WEIGHT = 9617;
+static const int RED_WEIGHT = 4899;
+
+GrayConverter::GrayConverter(const bool simd)
+    : simd_(simd && HasSimd())
+{
+}
+
+bool GrayConverter::HasSimd()
+{
+#ifdef __SSE2__
+  return true;
+#else
+  return false;
+#endif
+}
+
+void GrayConverter::Convert(const Mat& frame, const float factor, Mat* gray)
+{
+  if (ConvertFused(frame, factor, gray)) {
+    return;
+  }
+
+  // Luma comes first for YUYV, the conversion being a plain copy of it.
+  const Size size(frame.cols * factor, frame.rows * factor);
+  if (frame.type() == CV_8UC2) {
+    cvtColor(frame, *gray, CV_YUV2GRAY_YUYV);
+    if (factor != 1.0f) {
+      resize(*gray, *gray, size);
+    }
+  } else {
+    Mat resized = frame;
+    if (factor != 1.0f) {
+      resize(frame, resized, size);
+    }
+    cvtColor(resized, *gray, CV_BGR2GRAY);
+  }
+}
+
+bool GrayConverter::ConvertFused(const Mat& frame, const float factor,
+                                 Mat* gray)
+{
+  const int block = factor == 0.5f ? 2 : (factor == 0.25f ? 4 : 0);
+  const bool yuyv = frame.type() == CV_8UC2;
+  if (block == 0 || !(yuyv || frame.type() == CV_8UC3)) {
+    return false;
+  }
+
+  const int channels = frame.channels();
+  const int cols = frame.cols / block;
+  const int rows = frame.rows / block;
+  const int n = cols * block * channels;
+  // A block adds up to at most 16 * 255 per channel, so the weighted sum
+  // fits in 32 bits; the shifts divide by the weights and the area.
+  const int areaShift = block == 2 ? 2 : 4;
+  const int shift = areaShift + (yuyv ? 0 : WEIGHT_SHIFT);
+  const int round = 1 << (shift - 1);
+
+  gray->create(rows, cols, CV_8UC1);
+  sums_.resize(n);
+  rows_.resize(block);
+  for (int y = 0; y < rows; ++y) {
+    for (int i = 0; i < block; ++i) {
+      rows_[i] = frame.ptr<uint8_t>(y * block + i);
+    }
+    SumRows(&rows_[0], block, n, &sums_[0]);
+
+    uint8_t* out = gray->ptr<uint8_t>(y);
+    const uint16_t* sums = &sums_[0];
+    if (yuyv) {
+      // Luma is every other byte, chroma is left out.
+      for (int x = 0; x < cols; ++x, sums += 2 * block) {
+        int sum = 0;
+        for (int i = 0; i < block; ++i) {
+          sum += sums[2 * i];
+        }
+        out[x] = (sum + round) >> shift;
+      }
+    } else {
+      for (int x = 0; x < cols; ++x, sums += 3 * block) {
+        int blue = 0, green = 0, red = 0;
+        for (int i = 0; i < block; ++i) {
+          blue += sums[3 * i];
+          green += sums[3 * i + 1];
+          red += sums[3 * i + 2];
+        }
+        out[x] = (BLUE_WEIGHT * blue + GREEN_WEIGHT * green +
+                  RED_WEIGHT * red + round) >> shift;
+      }
+    }
+  }
+
+  return true;
+}
+
+void GrayConverter::SumRows(const uint8_t* const* rows, const int count,
+                            const int n, uint16_t* sums) const
+{
+  int i = 0;
+#ifdef __SSE2__
+  // 16 bytes of every row at a time, widened to two registers of 16 bit
+  // lanes. Unaligned, rows of ROIs start anywhere.
+  if (simd_) {
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+      __m128i low = zero;
+      __m128i high = zero;
+      for (int r = 0; r < count; ++r) {
+        const __m128i bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[r] + i));
+        low = _mm_add_epi16(low, _mm_unpacklo_epi8(bytes, zero));
+        high = _mm_add_epi16(high, _mm_unpackhi_epi8(bytes, zero));
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i), low);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i + 8), high);
+    }
+  }
+#endif
+
+  for (; i < n; ++i) {
+    int sum = 0;
+    for (int r = 0; r < count; ++r) {
+      sum += rows[r][i];
+    }
+    sums[i] = sum;
+  }
+}
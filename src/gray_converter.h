@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+// Turns camera frames, BGR or YUYV, into the grayscale working frame at a
+// fraction of their size. For factors 1/2 and 1/4 a fused pass averages
+// every block straight from the source, converting as it goes, so the full
+// resolution frame is read once and never written back. Blocks are
+// averaged like cv::INTER_AREA does. Other factors fall back to cv::resize
+// and cv::cvtColor.
+class GrayConverter
+{
+ public:
+  // Without simd the fused pass sticks to plain C++, which the SSE2 one
+  // has to match exactly.
+  GrayConverter(const bool simd = true);
+
+  // frame is CV_8UC3 BGR or CV_8UC2 YUYV.
+  void Convert(const cv::Mat& frame, const float factor, cv::Mat* gray);
+  // The fused pass alone. Returns false, leaving gray alone, for frames or
+  // factors it doesn't handle.
+  bool ConvertFused(const cv::Mat& frame, const float factor, cv::Mat* gray);
+
+  // Whether this build has the SSE2 pass.
+  static bool HasSimd();
+
+ private:
+  // Adds up rows of n bytes into sums, as 16 bit lanes.
+  void SumRows(const uint8_t* const* rows, const int count, const int n,
+               uint16_t* sums) const;
+
+  bool simd_;
+  // Column sums of the source rows of one output row.
+  std::vector<uint16_t> sums_;
+  std::vector<const uint8_t*> rows_;
+};
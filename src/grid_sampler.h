@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+
+#include "opencv2/opencv.hpp"
+
+#include "lens_model.h"
+
+// Reads the cells of a glyph with an N x N payload from a grayscale image.
+// The payload is framed by a ring of black cells one cell wide, so the quad
+// the blob detector finds is N + 2 cells wide: a size 3 glyph is a 5 x 5
+// square. The glyph's unit square is mapped onto the image by a homography,
+// so the same homography serves every grid size. Everything that depends on
+// N only - the cell geometry and the loop bounds - is a compile time
+// constant, which lets the compiler unroll the cell loops and fold the
+// sample coordinates.
+template <int N>
+class GridSampler
+{
+ public:
+  // Cells are packed row-major into a 64 bit code.
+  static_assert(N >= 1 && N * N <= 64, "grid does not fit into the code");
+
+  // Cells along each side of the quad, border included.
+  static const int GRID = N + 2;
+  // Samples per side of a cell.
+  static const int SAMPLES = 6;
+
+  // Samples the cells of the glyph, h being the row-major 3x3 homography
+  // from the unit square to the image. Bit r * N + c of code is set for a
+  // black payload cell. Returns false as soon as a cell is neither clearly
+  // black nor clearly white, or a border cell isn't black. When cells is
+  // given, it receives every sample, border included. With a lens, h maps
+  // to undistorted coordinates and every sample is distorted back into the
+  // image.
+  static bool Sample(const cv::Mat& image, const double* h,
+                     const LensModel* lens, uint64_t* code, cv::Mat* cells)
+  {
+    const float scale = lens ? lens->Scale(image.cols) : 1.0f;
+
+    // Unless a cell is overwhelmingly of a particular color, we should
+    // not classify it to be one.
+    const int count_threshold = (SAMPLES * SAMPLES * 4) / 5;
+    const uint8_t color_threshold = 128;
+
+    if (cells)
+    {
+      cells->create(GRID * SAMPLES, GRID * SAMPLES, CV_8UC1);
+    }
+
+    // Row by row, so that quads without a border mostly fail on the top
+    // row already.
+    uint64_t bits = 0;
+    for (int r = 0; r < GRID; ++r)
+    {
+      for (int c = 0; c < GRID; ++c)
+      {
+        int b_counter = 0;
+        for (int sy = 0; sy < SAMPLES; ++sy)
+        {
+          const double v = Coordinate(r, sy);
+          for (int sx = 0; sx < SAMPLES; ++sx)
+          {
+            const double u = Coordinate(c, sx);
+            const double w = h[6] * u + h[7] * v + h[8];
+            cv::Point2f point((h[0] * u + h[1] * v + h[2]) / w,
+                              (h[3] * u + h[4] * v + h[5]) / w);
+            if (lens)
+            {
+              point = lens->Distort(point, scale);
+            }
+            int x = int(point.x);
+            int y = int(point.y);
+            x = x < 0 ? 0 : (x >= image.cols ? image.cols - 1 : x);
+            y = y < 0 ? 0 : (y >= image.rows ? image.rows - 1 : y);
+            const uint8_t pixel_color = image.ptr<uint8_t>(y)[x];
+            b_counter += pixel_color < color_threshold;
+            if (cells)
+            {
+              cells->at<uint8_t>(r * SAMPLES + sy, c * SAMPLES + sx) =
+                  pixel_color;
+            }
+          }
+        }
+
+        const bool border =
+            r == 0 || c == 0 || r == GRID - 1 || c == GRID - 1;
+        if (b_counter >= count_threshold)
+        {
+          if (!border)
+          {
+            bits |= uint64_t(1) << ((r - 1) * N + c - 1);
+          }
+        }
+        else if (border ||
+                 b_counter > SAMPLES * SAMPLES - count_threshold)
+        {
+          return false;
+        }
+      }
+    }
+
+    *code = bits;
+    return true;
+  }
+
+ private:
+  // Only the inner part of a cell is sampled, so that blur across the cell
+  // borders doesn't spoil the count.
+  static constexpr double Margin()
+  {
+    return 0.2;
+  }
+
+  // Unit square coordinate of sample s of cell i along one axis.
+  static constexpr double Coordinate(int i, int s)
+  {
+    return (i + Margin() + (1.0 - 2.0 * Margin()) * (s + 0.5) / SAMPLES) /
+           GRID;
+  }
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "opencv2/opencv.hpp"
+
+// Image of T whose rows all start on a cache line, surrounded by a border of
+// padding pixels on every side, so that neighbour lookups near the edges
+// need no bounds checks. Row(y) points at pixel (y, 0); the border is at
+// negative indices and past the last row and column.
+//
+// The pixels live in a cv::Mat, so copies share them like cv::Mat does and
+// AsMat() hands them to OpenCV without copying. Images can also view the
+// pixels of an existing cv::Mat, without border or alignment.
+template <typename T>
+class Image
+{
+ public:
+  static const int ALIGNMENT = 64;
+
+  Image()
+      : rows_(0)
+      , cols_(0)
+      , border_(0)
+      , stride_(0)
+      , origin_(nullptr)
+  {
+  }
+
+  Image(const int rows, const int cols, const int border)
+      : rows_(rows)
+      , cols_(cols)
+      , border_(border)
+  {
+    const int perLine = ALIGNMENT / sizeof(T);
+    stride_ = (cols + 2 * border + perLine - 1) / perLine * perLine;
+
+    // One more line than needed, to move the first pixel onto a line.
+    cv::Mat storage(rows + 2 * border, stride_ + perLine,
+                    cv::DataType<T>::type);
+    const uintptr_t first =
+        reinterpret_cast<uintptr_t>(storage.ptr<T>() + border);
+    const int offset =
+        (ALIGNMENT - first % ALIGNMENT) % ALIGNMENT / sizeof(T);
+    pixels_ = storage(cv::Rect(offset, 0, cols + 2 * border,
+                               rows + 2 * border));
+    stride_ = pixels_.step / sizeof(T);
+    origin_ = pixels_.ptr<T>(border) + border;
+  }
+
+  explicit Image(const cv::Mat& mat)
+      : rows_(mat.rows)
+      , cols_(mat.cols)
+      , border_(0)
+      , stride_(mat.step / sizeof(T))
+      , pixels_(mat)
+      , origin_(reinterpret_cast<T*>(mat.data))
+  {
+  }
+
+  int Rows() const { return rows_; }
+  int Cols() const { return cols_; }
+  int Border() const { return border_; }
+  // Distance between two rows, in pixels.
+  ptrdiff_t Stride() const { return stride_; }
+
+  // Valid from -Border() to Rows() + Border() - 1.
+  T* Row(const int y) { return origin_ + y * stride_; }
+  const T* Row(const int y) const { return origin_ + y * stride_; }
+
+  // Sets every pixel, the border included.
+  void Fill(const T value)
+  {
+    for (int y = -border_; y < rows_ + border_; ++y) {
+      T* row = Row(y);
+      for (int x = -border_; x < cols_ + border_; ++x) {
+        row[x] = value;
+      }
+    }
+  }
+
+  // The pixels without the border, and with it.
+  cv::Mat AsMat() const
+  {
+    return pixels_(cv::Rect(border_, border_, cols_, rows_));
+  }
+  cv::Mat AsPaddedMat() const { return pixels_; }
+
+ private:
+  int rows_;
+  int cols_;
+  int border_;
+  ptrdiff_t stride_;
+  cv::Mat pixels_;
+  T* origin_;
+};
@@ -0,0 +1,157 @@
+#include "jpeg_decoder.h"
+
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+// Scanlines handed to libjpeg per call.
+static const int ROWS_PER_READ = 16;
+// Bytes read from an MJPEG file at a time.
+static const size_t CHUNK_SIZE = 1 << 16;
+
+static const uint8_t SOI = 0xd8;
+static const uint8_t EOI = 0xd9;
+
+JpegDecoder::JpegDecoder()
+{
+  info_.err = jpeg_std_error(&error_.base);
+  error_.base.error_exit = OnError;
+  jpeg_create_decompress(&info_);
+}
+
+JpegDecoder::~JpegDecoder()
+{
+  jpeg_destroy_decompress(&info_);
+}
+
+int JpegDecoder::ScaleDenominator(const float factor)
+{
+  int denominator = 1;
+  while (denominator < 8 && factor * denominator * 2 <= 1.0f) {
+    denominator *= 2;
+  }
+  return denominator;
+}
+
+void JpegDecoder::OnError(j_common_ptr info)
+{
+  // err is the first member of ErrorManager.
+  ErrorManager* error = reinterpret_cast<ErrorManager*>(info->err);
+  (*info->err->output_message)(info);
+  longjmp(error->jump, 1);
+}
+
+bool JpegDecoder::Decode(const uint8_t* data, const size_t size,
+                         const int denominator, Mat* gray)
+{
+  if (setjmp(error_.jump)) {
+    jpeg_abort_decompress(&info_);
+    return false;
+  }
+
+  jpeg_mem_src(&info_, const_cast<uint8_t*>(data), size);
+  if (jpeg_read_header(&info_, TRUE) != JPEG_HEADER_OK) {
+    jpeg_abort_decompress(&info_);
+    return false;
+  }
+
+  // Cameras often leave the Huffman tables out of MJPEG frames;
+  // libjpeg-turbo falls back to the standard ones.
+  info_.out_color_space = JCS_GRAYSCALE;
+  info_.scale_num = 1;
+  info_.scale_denom = denominator;
+  info_.dct_method = JDCT_IFAST;
+  jpeg_start_decompress(&info_);
+
+  gray->create(info_.output_height, info_.output_width, CV_8UC1);
+  JSAMPROW rows[ROWS_PER_READ];
+  while (info_.output_scanline < info_.output_height) {
+    const int count = min<int>(ROWS_PER_READ,
+                               info_.output_height - info_.output_scanline);
+    for (int i = 0; i < count; ++i) {
+      rows[i] = gray->ptr<uchar>(info_.output_scanline + i);
+    }
+    jpeg_read_scanlines(&info_, rows, count);
+  }
+
+  jpeg_finish_decompress(&info_);
+  return true;
+}
+
+MjpegReader::MjpegReader(const string& filename)
+    : file_(fopen(filename.c_str(), "rb"))
+    , position_(0)
+{
+  if (!file_) {
+    throw "Unable to open MJPEG file";
+  }
+}
+
+MjpegReader::~MjpegReader()
+{
+  fclose(file_);
+}
+
+bool MjpegReader::Next(Mat* frame)
+{
+  // Start of the frame.
+  size_t start;
+  while ((start = Find(SOI, position_)) == string::npos) {
+    // Keeps a trailing 0xff, it may be the first half of the marker.
+    if (!buffer_.empty()) {
+      position_ = buffer_.size() - 1;
+    }
+    if (!Fill()) {
+      return false;
+    }
+  }
+  position_ = start;
+
+  // End of the frame, searched again from the start after every refill as
+  // Fill moves the data.
+  size_t end;
+  while ((end = Find(EOI, position_ + 2)) == string::npos) {
+    if (!Fill()) {
+      return false;
+    }
+  }
+
+  const size_t length = end + 2 - position_;
+  frame->create(1, length, CV_8UC1);
+  copy(buffer_.begin() + position_, buffer_.begin() + end + 2,
+       frame->ptr<uint8_t>());
+  position_ = end + 2;
+
+  return true;
+}
+
+void MjpegReader::Rewind()
+{
+  rewind(file_);
+  buffer_.clear();
+  position_ = 0;
+}
+
+bool MjpegReader::Fill()
+{
+  buffer_.erase(buffer_.begin(), buffer_.begin() + position_);
+  position_ = 0;
+
+  const size_t size = buffer_.size();
+  buffer_.resize(size + CHUNK_SIZE);
+  const size_t count = fread(&buffer_[size], 1, CHUNK_SIZE, file_);
+  buffer_.resize(size + count);
+
+  return count > 0;
+}
+
+size_t MjpegReader::Find(const uint8_t marker, const size_t from) const
+{
+  for (size_t i = from; i + 1 < buffer_.size(); ++i) {
+    if (buffer_[i] == 0xff && buffer_[i + 1] == marker) {
+      return i;
+    }
+  }
+  return string::npos;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <csetjmp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <jpeglib.h>
+
+#include "opencv2/opencv.hpp"
+
+// Decodes JPEG frames, e.g. from an MJPEG camera, straight to grayscale at
+// a reduced scale. libjpeg scales in the DCT domain and skips the chroma
+// planes, so the full resolution color image is never reconstructed.
+class JpegDecoder
+{
+ public:
+  JpegDecoder();
+  ~JpegDecoder();
+
+  // Largest scale denominator libjpeg supports (1, 2, 4 or 8) that doesn't
+  // shrink the image more than factor does.
+  static int ScaleDenominator(const float factor);
+
+  // Decodes to 8 bit grayscale at 1/denominator of the size, rounded up.
+  // Returns false for corrupt data.
+  bool Decode(const uint8_t* data, const size_t size, const int denominator,
+              cv::Mat* gray);
+
+ private:
+  // libjpeg reports fatal errors through a callback that must not return.
+  struct ErrorManager
+  {
+    jpeg_error_mgr base;
+    jmp_buf jump;
+  };
+
+  static void OnError(j_common_ptr info);
+
+  jpeg_decompress_struct info_;
+  ErrorManager error_;
+};
+
+// Splits an MJPEG stream - a plain concatenation of JPEG images like the
+// ones `ffmpeg -f mjpeg` writes - into frames at the SOI and EOI markers.
+// Entropy coded data stuffs every 0xff byte, so markers can't appear in it.
+class MjpegReader
+{
+ public:
+  MjpegReader(const std::string& filename);
+  ~MjpegReader();
+
+  // Copies the next encoded frame into a single row Mat, the same layout
+  // cameras deliver encoded frames in. Returns false at the end of the file.
+  bool Next(cv::Mat* frame);
+  void Rewind();
+
+ private:
+  // Reads more of the file, dropping what is before position_. Returns
+  // false at the end of the file.
+  bool Fill();
+  // Offset of the marker at or after from, or npos.
+  size_t Find(const uint8_t marker, const size_t from) const;
+
+  FILE* file_;
+  std::vector<uint8_t> buffer_;
+  size_t position_;
+};
@@ -0,0 +1,161 @@
+#include "lens_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "configuration.h"
+
+using namespace cv;
+using namespace std;
+
+// Part of the larger side of the frame the grids extend past every edge,
+// enough for the corrected corners of usual wide-angle lenses.
+static const float GRID_MARGIN = 0.25f;
+// Every key the model is built from.
+static const char* const KEYS[] = {
+  "lens_calibration_width", "lens_calibration_height", "lens_fx", "lens_fy",
+  "lens_cx", "lens_cy", "lens_k1", "lens_k2", "lens_p1", "lens_p2",
+  "lens_k3", "lens_grid_step"
+};
+
+LensModel::LensModel()
+    : enabled_(false)
+    , width_(1)
+    , step_(1)
+    , margin_(0)
+    , gridRows_(0)
+    , gridCols_(0)
+    , generation_(Configuration::Instance().Generation())
+{
+  ReadKeys(&keys_);
+  Build();
+}
+
+void LensModel::Update()
+{
+  Configuration& config = Configuration::Instance();
+  const long generation = config.Generation();
+  if (generation == generation_) {
+    return;
+  }
+  generation_ = generation;
+
+  vector<double> keys;
+  ReadKeys(&keys);
+  if (keys == keys_) {
+    return;
+  }
+  keys_.swap(keys);
+
+  try {
+    Build();
+  } catch (const char* error) {
+    cout << error << ", lens correction disabled" << endl;
+    enabled_ = false;
+  }
+}
+
+void LensModel::ReadKeys(vector<double>* keys)
+{
+  Configuration& config = Configuration::Instance();
+  keys->clear();
+  for (auto name : KEYS) {
+    keys->push_back(config.ReadDouble(name));
+  }
+}
+
+void LensModel::Build()
+{
+  Configuration& config = Configuration::Instance();
+  const double k1 = config.ReadDouble("lens_k1");
+  const double k2 = config.ReadDouble("lens_k2");
+  const double p1 = config.ReadDouble("lens_p1");
+  const double p2 = config.ReadDouble("lens_p2");
+  const double k3 = config.ReadDouble("lens_k3");
+  enabled_ = k1 != 0 || k2 != 0 || p1 != 0 || p2 != 0 || k3 != 0;
+  if (!enabled_) {
+    return;
+  }
+
+  width_ = config.ReadInt("lens_calibration_width");
+  const int height = config.ReadInt("lens_calibration_height");
+  step_ = config.ReadFloat("lens_grid_step");
+  if (width_ <= 0 || height <= 0 || step_ <= 0) {
+    throw "Invalid lens calibration";
+  }
+  margin_ = GRID_MARGIN * max(width_, height);
+  gridCols_ = int(ceil((width_ + 2 * margin_) / step_)) + 1;
+  gridRows_ = int(ceil((height + 2 * margin_) / step_)) + 1;
+
+  const double fx = config.ReadDouble("lens_fx");
+  const double fy = config.ReadDouble("lens_fy");
+  const double cx = config.ReadDouble("lens_cx");
+  const double cy = config.ReadDouble("lens_cy");
+
+  vector<Point2f> nodes;
+  for (int row = 0; row < gridRows_; ++row) {
+    for (int col = 0; col < gridCols_; ++col) {
+      nodes.push_back(Point2f(col * step_ - margin_, row * step_ - margin_));
+    }
+  }
+
+  // The distortion has a closed form.
+  distorted_.clear();
+  for (auto& node : nodes) {
+    const double x = (node.x - cx) / fx;
+    const double y = (node.y - cy) / fy;
+    const double r2 = x * x + y * y;
+    const double radial = 1 + r2 * (k1 + r2 * (k2 + r2 * k3));
+    const double xd = x * radial + 2 * p1 * x * y + p2 * (r2 + 2 * x * x);
+    const double yd = y * radial + p1 * (r2 + 2 * y * y) + 2 * p2 * x * y;
+    distorted_.push_back(Point2f(fx * xd + cx, fy * yd + cy));
+  }
+
+  // Its inverse doesn't; OpenCV solves for it iteratively, which is too
+  // slow per point and frame but fine once per node.
+  Mat camera = Mat::zeros(3, 3, CV_64F);
+  camera.at<double>(0, 0) = fx;
+  camera.at<double>(0, 2) = cx;
+  camera.at<double>(1, 1) = fy;
+  camera.at<double>(1, 2) = cy;
+  camera.at<double>(2, 2) = 1;
+  Mat coefficients = Mat::zeros(1, 5, CV_64F);
+  coefficients.at<double>(0, 0) = k1;
+  coefficients.at<double>(0, 1) = k2;
+  coefficients.at<double>(0, 2) = p1;
+  coefficients.at<double>(0, 3) = p2;
+  coefficients.at<double>(0, 4) = k3;
+  undistortPoints(nodes, undistorted_, camera, coefficients, Mat(), camera);
+}
+
+float LensModel::Scale(const int width) const
+{
+  return float(width) / width_;
+}
+
+Point2f LensModel::Undistort(const Point2f& point, const float scale) const
+{
+  return Lookup(undistorted_, point * (1.0f / scale)) * scale;
+}
+
+Point2f LensModel::Distort(const Point2f& point, const float scale) const
+{
+  return Lookup(distorted_, point * (1.0f / scale)) * scale;
+}
+
+Point2f LensModel::Lookup(const vector<Point2f>& grid,
+                          const Point2f& point) const
+{
+  const float gx = (point.x + margin_) / step_;
+  const float gy = (point.y + margin_) / step_;
+  const int col = min(max(int(floor(gx)), 0), gridCols_ - 2);
+  const int row = min(max(int(floor(gy)), 0), gridRows_ - 2);
+  const float u = gx - col;
+  const float v = gy - row;
+
+  const Point2f* top = &grid[row * gridCols_ + col];
+  const Point2f* bottom = top + gridCols_;
+  return (top[0] * (1 - u) + top[1] * u) * (1 - v) +
+         (bottom[0] * (1 - u) + bottom[1] * u) * v;
+}
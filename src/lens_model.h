@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+// Radial and tangential distortion of the camera lens, from the lens_*
+// calibration keys in the model of cv::calibrateCamera. Instead of
+// remapping whole frames, single points are corrected: both directions of
+// the distortion are tabulated on a coarse grid over the calibrated frame,
+// with a margin around it, and interpolated bilinearly. The grids are only
+// rebuilt when the keys change.
+class LensModel
+{
+ public:
+  // Reads the configuration. The model is disabled while every distortion
+  // coefficient is zero.
+  LensModel();
+
+  // Rebuilds the model if any lens_* key changed since it was built. Cheap
+  // while the configuration stays the same.
+  void Update();
+
+  bool Enabled() const { return enabled_; }
+
+  // Scale of a frame width pixels wide relative to the calibrated one.
+  float Scale(const int width) const;
+
+  // From the image through the lens to where an ideal lens with the same
+  // intrinsics would have put the point, and back. Points are in a frame
+  // scaled by scale from the calibrated resolution.
+  cv::Point2f Undistort(const cv::Point2f& point, const float scale) const;
+  cv::Point2f Distort(const cv::Point2f& point, const float scale) const;
+
+ private:
+  // Bilinear interpolation of a grid at a point in calibrated coordinates.
+  // Beyond the grid it extrapolates from the nearest cell.
+  cv::Point2f Lookup(const std::vector<cv::Point2f>& grid,
+                     const cv::Point2f& point) const;
+
+  static void ReadKeys(std::vector<double>* keys);
+  // Throws for an invalid calibration.
+  void Build();
+
+  bool enabled_;
+  int width_;
+  float step_;
+  // Node (row, col) of a grid is at (col, row) * step_ - margin_.
+  float margin_;
+  int gridRows_;
+  int gridCols_;
+  std::vector<cv::Point2f> undistorted_;
+  std::vector<cv::Point2f> distorted_;
+  // Configuration the model was built from.
+  long generation_;
+  std::vector<double> keys_;
+};
@@ -17,16 +17,30 @@ int main()
   GlyphDetector detector("glyph_schema.txt");
   Game game;
 
-  vector<Glyph> glyphs;
+  vector<GlyphEvent> events;
+  bool resync = false;
+  long sequence = 0;
   while (game.Status() != GameStatus::Exit)
   {
-    if (detector.GetGlyphs(&glyphs)) {
-      // TODO: Update the bricks of the game.
+    // Sleep until the detector publishes new results or the game is due for
+    // its next simulation step, whichever comes first.
+    if (detector.WaitForEvents(game.MillisecondsUntilNextStep(), &sequence,
+                               &events, &resync)) {
+      game.OnGlyphEvents(events, resync);
     }
 
     game.Tick();
   }
 
+  const PredictionStats stats = game.GetPredictionStats();
+  cout << "Average input-to-screen latency: "
+       << game.AverageInputLatencyMs() << " ms" << endl;
+  cout << "Pose prediction error over " << stats.samples << " samples: "
+       << stats.meanCenterError << " px mean, "
+       << stats.rmsCenterError << " px rms, "
+       << stats.maxCenterError << " px max, "
+       << stats.meanAngleError << " deg mean" << endl;
+
   detector.Stop();
   Configuration::Instance().Stop();
   return 0;
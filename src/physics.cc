@@ -0,0 +1,189 @@
+#include "physics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+
+Physics::Physics(const float width, const float height, const float cellSize)
+    : width_(width)
+    , height_(height)
+    , grid_(cellSize)
+    , narrowPhaseTests_(0)
+{
+  ball_.x = width / 2;
+  ball_.y = height / 2;
+  ball_.vx = 0;
+  ball_.vy = 0;
+  ball_.radius = 1;
+}
+
+Physics::~Physics()
+{
+}
+
+int Physics::AddBrick(const Aabb& bounds)
+{
+  int id;
+  if (freeIds_.empty()) {
+    id = bricks_.size();
+    bricks_.push_back(bounds);
+    alive_.push_back(true);
+  } else {
+    id = freeIds_.back();
+    freeIds_.pop_back();
+    bricks_[id] = bounds;
+    alive_[id] = true;
+  }
+
+  grid_.Update(id, bounds);
+  return id;
+}
+
+void Physics::MoveBrick(const int id, const Aabb& bounds)
+{
+  assert(IsAlive(id));
+  if (!IsAlive(id)) {
+    return;
+  }
+
+  bricks_[id] = bounds;
+  grid_.Update(id, bounds);
+}
+
+void Physics::RemoveBrick(const int id)
+{
+  // Freeing an id twice would hand the slot to two bricks later on.
+  assert(IsAlive(id));
+  if (!IsAlive(id)) {
+    return;
+  }
+
+  grid_.Remove(id);
+  alive_[id] = false;
+  freeIds_.push_back(id);
+}
+
+bool Physics::IsAlive(const int id) const
+{
+  return id >= 0 && size_t(id) < alive_.size() && alive_[id];
+}
+
+void Physics::SetBall(const Ball& ball)
+{
+  ball_ = ball;
+}
+
+const Ball& Physics::GetBall() const
+{
+  return ball_;
+}
+
+void Physics::Step(const float dt)
+{
+  hits_.clear();
+  narrowPhaseTests_ = 0;
+
+  // Split fast moves so the ball never travels more than its radius at once
+  // and can't tunnel through thin bricks.
+  const float distance = sqrt(ball_.vx * ball_.vx + ball_.vy * ball_.vy) * dt;
+  const int substeps = max(1, static_cast<int>(ceil(distance / ball_.radius)));
+  for (int i = 0; i < substeps; ++i) {
+    Advance(dt / substeps);
+  }
+}
+
+const vector<int>& Physics::Hits() const
+{
+  return hits_;
+}
+
+int Physics::NarrowPhaseTests() const
+{
+  return narrowPhaseTests_;
+}
+
+void Physics::Advance(const float dt)
+{
+  ball_.x += ball_.vx * dt;
+  ball_.y += ball_.vy * dt;
+
+  // Walls.
+  if (ball_.x - ball_.radius < 0) {
+    ball_.x = ball_.radius;
+    ball_.vx = fabs(ball_.vx);
+  } else if (ball_.x + ball_.radius > width_) {
+    ball_.x = width_ - ball_.radius;
+    ball_.vx = -fabs(ball_.vx);
+  }
+  if (ball_.y - ball_.radius < 0) {
+    ball_.y = ball_.radius;
+    ball_.vy = fabs(ball_.vy);
+  } else if (ball_.y + ball_.radius > height_) {
+    ball_.y = height_ - ball_.radius;
+    ball_.vy = -fabs(ball_.vy);
+  }
+
+  // Broad phase: only bricks sharing a cell with the ball.
+  Aabb bounds;
+  bounds.x0 = ball_.x - ball_.radius;
+  bounds.y0 = ball_.y - ball_.radius;
+  bounds.x1 = ball_.x + ball_.radius;
+  bounds.y1 = ball_.y + ball_.radius;
+
+  nearby_.clear();
+  grid_.Query(bounds, &nearby_);
+
+  for (int id : nearby_) {
+    ++narrowPhaseTests_;
+    if (Collide(bricks_[id]) &&
+        find(hits_.begin(), hits_.end(), id) == hits_.end()) {
+      hits_.push_back(id);
+    }
+  }
+}
+
+bool Physics::Collide(const Aabb& brick)
+{
+  // Closest point of the box to the center of the ball.
+  const float cx = min(max(ball_.x, brick.x0), brick.x1);
+  const float cy = min(max(ball_.y, brick.y0), brick.y1);
+  float nx = ball_.x - cx;
+  float ny = ball_.y - cy;
+  const float squaredDistance = nx * nx + ny * ny;
+
+  if (squaredDistance >= ball_.radius * ball_.radius) {
+    return false;
+  }
+
+  float penetration;
+  if (squaredDistance > 0) {
+    const float distance = sqrt(squaredDistance);
+    nx /= distance;
+    ny /= distance;
+    penetration = ball_.radius - distance;
+  } else {
+    // The center is inside the box, leave through the closest side.
+    const float left = ball_.x - brick.x0;
+    const float right = brick.x1 - ball_.x;
+    const float top = ball_.y - brick.y0;
+    const float bottom = brick.y1 - ball_.y;
+    const float nearest = min(min(left, right), min(top, bottom));
+    nx = nearest == left ? -1 : (nearest == right ? 1 : 0);
+    ny = nx != 0 ? 0 : (nearest == top ? -1 : 1);
+    penetration = nearest + ball_.radius;
+  }
+
+  ball_.x += nx * penetration;
+  ball_.y += ny * penetration;
+
+  // Reflect the velocity only when moving into the brick.
+  const float approach = ball_.vx * nx + ball_.vy * ny;
+  if (approach < 0) {
+    ball_.vx -= 2 * approach * nx;
+    ball_.vy -= 2 * approach * ny;
+  }
+
+  return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "spatial_hash.h"
+
+struct Ball
+{
+  // Center, velocity in pixels per second and radius.
+  float x, y;
+  float vx, vy;
+  float radius;
+};
+
+// Ball against bricks and the borders of the play area. Bricks are treated
+// as axis-aligned boxes and indexed in a spatial hash, so a step only tests
+// the ball against bricks in the cells it passes through.
+class Physics
+{
+ public:
+  Physics(const float width, const float height, const float cellSize);
+  ~Physics();
+
+  int AddBrick(const Aabb& bounds);
+  // Both ignore ids of removed bricks; debug builds assert on them.
+  void MoveBrick(const int id, const Aabb& bounds);
+  void RemoveBrick(const int id);
+
+  void SetBall(const Ball& ball);
+  const Ball& GetBall() const;
+
+  // Advances the ball by dt seconds, bouncing off walls and bricks.
+  void Step(const float dt);
+  // Bricks hit during the last step.
+  const std::vector<int>& Hits() const;
+  // Circle/box tests run during the last step, for profiling.
+  int NarrowPhaseTests() const;
+
+ private:
+  bool IsAlive(const int id) const;
+  void Advance(const float dt);
+  bool Collide(const Aabb& brick);
+
+  const float width_;
+  const float height_;
+  SpatialHash grid_;
+  std::vector<Aabb> bricks_;
+  std::vector<bool> alive_;
+  std::vector<int> freeIds_;
+  Ball ball_;
+
+  std::vector<int> nearby_;
+  std::vector<int> hits_;
+  int narrowPhaseTests_;
+};
@@ -0,0 +1,211 @@
+#include "pose_tracker.h"
+
+#include <cmath>
+
+#include "configuration.h"
+
+using namespace cv;
+using namespace std;
+
+// Predictions are only extrapolated this far past the last measurement.
+static const double MAX_EXTRAPOLATION_S = 0.25;
+
+// Wraps an angle difference in degrees into [-180, 180).
+static double WrapAngle(double angle)
+{
+  angle = fmod(angle + 180.0, 360.0);
+  if (angle < 0) {
+    angle += 360.0;
+  }
+
+  return angle - 180.0;
+}
+
+KalmanAxis::KalmanAxis()
+{
+  Reset(0.0);
+}
+
+void KalmanAxis::Reset(const double value)
+{
+  value_ = value;
+  velocity_ = 0.0;
+  // Unknown velocity: large initial uncertainty.
+  p00_ = 1.0;
+  p01_ = 0.0;
+  p11_ = 1e4;
+}
+
+void KalmanAxis::Predict(const double dt, const double processNoise)
+{
+  value_ += velocity_ * dt;
+
+  // P = F P F' + Q, with F = [1 dt; 0 1] and Q of a white acceleration.
+  const double dt2 = dt * dt;
+  p00_ += 2 * dt * p01_ + dt2 * p11_ + processNoise * dt2 * dt / 3;
+  p01_ += dt * p11_ + processNoise * dt2 / 2;
+  p11_ += processNoise * dt;
+}
+
+void KalmanAxis::Correct(const double measurement,
+                         const double measurementNoise)
+{
+  const double innovation = measurement - value_;
+  const double s = p00_ + measurementNoise;
+  const double k0 = p00_ / s;
+  const double k1 = p01_ / s;
+
+  value_ += k0 * innovation;
+  velocity_ += k1 * innovation;
+
+  p11_ -= k1 * p01_;
+  p01_ -= k0 * p01_;
+  p00_ -= k0 * p00_;
+}
+
+double KalmanAxis::Extrapolate(const double dt) const
+{
+  return value_ + velocity_ * dt;
+}
+
+double KalmanAxis::Value() const
+{
+  return value_;
+}
+
+PoseTracker::PoseTracker()
+    : samples_(0)
+    , centerErrorSum_(0.0)
+    , squaredCenterErrorSum_(0.0)
+    , maxCenterError_(0.0)
+    , angleErrorSum_(0.0)
+{
+}
+
+PoseTracker::~PoseTracker()
+{
+}
+
+void PoseTracker::Measure(const int track, const Pose& pose,
+                          const Clock::time_point captured, const bool resting)
+{
+  const double processNoise =
+      Configuration::Instance().ReadDouble("pose_process_noise");
+  const double measurementNoise =
+      Configuration::Instance().ReadDouble("pose_measurement_noise");
+  const double angleProcessNoise =
+      Configuration::Instance().ReadDouble("pose_angle_process_noise");
+  const double angleMeasurementNoise =
+      Configuration::Instance().ReadDouble("pose_angle_measurement_noise");
+
+  auto it = tracks_.find(track);
+  if (it == tracks_.end()) {
+    Track& added = tracks_[track];
+    added.x.Reset(pose.center.x);
+    added.y.Reset(pose.center.y);
+    added.angle.Reset(pose.angle);
+    added.updated = captured;
+    return;
+  }
+
+  const double dt =
+      chrono::duration<double>(captured - it->second.updated).count();
+  Correct(&it->second, pose, dt, processNoise, measurementNoise,
+          angleProcessNoise, angleMeasurementNoise);
+  if (resting) {
+    // No more measurements follow until it moves again, so any velocity
+    // left would carry it past where it stopped.
+    it->second.x.Reset(pose.center.x);
+    it->second.y.Reset(pose.center.y);
+    it->second.angle.Reset(pose.angle);
+  }
+  it->second.updated = captured;
+}
+
+void PoseTracker::Remove(const int track)
+{
+  tracks_.erase(track);
+}
+
+void PoseTracker::Clear()
+{
+  tracks_.clear();
+}
+
+void PoseTracker::Correct(Track* track, const Pose& pose, const double dt,
+                          const double processNoise,
+                          const double measurementNoise,
+                          const double angleProcessNoise,
+                          const double angleMeasurementNoise)
+{
+  track->x.Predict(dt, processNoise);
+  track->y.Predict(dt, processNoise);
+  track->angle.Predict(dt, angleProcessNoise);
+
+  // Score the prediction against the measurement before correcting it.
+  const double dx = pose.center.x - track->x.Value();
+  const double dy = pose.center.y - track->y.Value();
+  const double centerError = sqrt(dx * dx + dy * dy);
+  // Unwrap the measured angle next to the prediction.
+  const double angleError = WrapAngle(pose.angle - track->angle.Value());
+
+  ++samples_;
+  centerErrorSum_ += centerError;
+  squaredCenterErrorSum_ += centerError * centerError;
+  maxCenterError_ = max(maxCenterError_, centerError);
+  angleErrorSum_ += fabs(angleError);
+
+  track->x.Correct(pose.center.x, measurementNoise);
+  track->y.Correct(pose.center.y, measurementNoise);
+  track->angle.Correct(track->angle.Value() + angleError,
+                       angleMeasurementNoise);
+}
+
+void PoseTracker::Predict(const Clock::time_point time,
+                          map<int, Pose>* poses) const
+{
+  poses->clear();
+  for (auto& entry : tracks_) {
+    const Track& track = entry.second;
+    const double dt = min(
+        chrono::duration<double>(time - track.updated).count(),
+        MAX_EXTRAPOLATION_S);
+
+    Pose& pose = (*poses)[entry.first];
+    pose.center = Point2d(track.x.Extrapolate(dt), track.y.Extrapolate(dt));
+    pose.angle = track.angle.Extrapolate(dt);
+  }
+}
+
+void PoseTracker::PredictActive(const Clock::time_point time,
+                                map<int, Pose>* poses) const
+{
+  poses->clear();
+  for (auto& entry : tracks_) {
+    const Track& track = entry.second;
+    const double age = chrono::duration<double>(time - track.updated).count();
+    // Reported a little past the end of the extrapolation, so that the
+    // final pose is seen at least once.
+    if (age > 2 * MAX_EXTRAPOLATION_S) {
+      continue;
+    }
+
+    const double dt = min(age, MAX_EXTRAPOLATION_S);
+    Pose& pose = (*poses)[entry.first];
+    pose.center = Point2d(track.x.Extrapolate(dt), track.y.Extrapolate(dt));
+    pose.angle = track.angle.Extrapolate(dt);
+  }
+}
+
+PredictionStats PoseTracker::Stats() const
+{
+  PredictionStats stats;
+  stats.samples = samples_;
+  stats.meanCenterError = samples_ ? centerErrorSum_ / samples_ : 0.0;
+  stats.rmsCenterError =
+      samples_ ? sqrt(squaredCenterErrorSum_ / samples_) : 0.0;
+  stats.maxCenterError = maxCenterError_;
+  stats.meanAngleError = samples_ ? angleErrorSum_ / samples_ : 0.0;
+
+  return stats;
+}
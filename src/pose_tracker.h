@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+struct Pose
+{
+  cv::Point2d center;
+  double angle;
+};
+
+// How far predictions were from the measurements that followed them.
+struct PredictionStats
+{
+  long samples;
+  double meanCenterError;
+  double rmsCenterError;
+  double maxCenterError;
+  double meanAngleError;
+};
+
+// Kalman filter on a single value moving at constant velocity.
+class KalmanAxis
+{
+ public:
+  KalmanAxis();
+
+  void Reset(const double value);
+  // Advances the state by dt seconds; processNoise is the variance of the
+  // acceleration that the model ignores.
+  void Predict(const double dt, const double processNoise);
+  void Correct(const double measurement, const double measurementNoise);
+  // Value dt seconds after the current state, without changing it.
+  double Extrapolate(const double dt) const;
+  double Value() const;
+
+ private:
+  double value_;
+  double velocity_;
+  // Covariance of value and velocity.
+  double p00_, p01_, p11_;
+};
+
+// Follows every glyph track reported by the detector with a constant
+// velocity model on its center and angle, so poses can be extrapolated to
+// any time, e.g. the moment a frame is rendered, while detection runs at a
+// lower rate.
+class PoseTracker
+{
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  PoseTracker();
+  ~PoseTracker();
+
+  // Feeds the pose of a track measured in a frame captured at the given
+  // time; unknown tracks are started there. A resting glyph has stopped
+  // moving, and its velocity is reset rather than estimated. The center is
+  // filtered with pose_process_noise and pose_measurement_noise, in pixels,
+  // the angle with pose_angle_process_noise and
+  // pose_angle_measurement_noise, in degrees.
+  void Measure(const int track, const Pose& pose,
+               const Clock::time_point captured, const bool resting);
+  void Remove(const int track);
+  void Clear();
+  // Poses of all tracks, keyed by track id, extrapolated to time.
+  void Predict(const Clock::time_point time, std::map<int, Pose>* poses) const;
+  // Like Predict, but only for the tracks measured recently enough to be
+  // still extrapolated; the poses of the others don't change any more.
+  void PredictActive(const Clock::time_point time,
+                     std::map<int, Pose>* poses) const;
+  PredictionStats Stats() const;
+
+ private:
+  struct Track
+  {
+    KalmanAxis x, y, angle;
+    Clock::time_point updated;
+  };
+
+  void Correct(Track* track, const Pose& pose, const double dt,
+               const double processNoise, const double measurementNoise,
+               const double angleProcessNoise,
+               const double angleMeasurementNoise);
+
+  std::map<int, Track> tracks_;
+
+  long samples_;
+  double centerErrorSum_;
+  double squaredCenterErrorSum_;
+  double maxCenterError_;
+  double angleErrorSum_;
+};
@@ -0,0 +1,335 @@
+#include "session_log.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace cv;
+using namespace std;
+
+static const char MAGIC[8] = { 'G', 'L', 'Y', 'P', 'H', 'L', 'O', 'G' };
+static const uint32_t VERSION = 2;
+// The header takes the first page, the configuration snapshot the rest of
+// the space before the ring.
+static const size_t HEADER_SIZE = 4096;
+static const size_t RING_OFFSET = 64 * 1024;
+static const size_t CONFIG_CAPACITY = RING_OFFSET - HEADER_SIZE;
+
+enum RecordType
+{
+  PaddingRecord = 0,
+  FrameRecord
+};
+
+struct RecordHeader
+{
+  uint32_t size;
+  uint32_t type;
+};
+
+// Fixed part of a frame record. It is followed by the pixels, padded to 4
+// bytes, the candidate vertices, the glyphs, the number of vertices of
+// every region and the region vertices.
+struct FrameHeader
+{
+  int64_t sequence;
+  int64_t capturedNs;
+  float processingMs;
+  float latencyMs;
+  float resizeFactor;
+  int32_t degradationLevel;
+  int32_t rows;
+  int32_t cols;
+  int32_t vertexCount;
+  int32_t glyphCount;
+  int32_t regionCount;
+  int32_t regionVertexCount;
+};
+
+static uint64_t Align(const uint64_t size, const uint64_t alignment)
+{
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static uint64_t FrameSize(const FrameHeader& fields)
+{
+  return Align(sizeof(RecordHeader) + sizeof(FrameHeader) +
+               Align(uint64_t(fields.rows) * fields.cols, 4) +
+               uint64_t(fields.vertexCount) * sizeof(Point2f) +
+               uint64_t(fields.glyphCount) * sizeof(LoggedGlyph) +
+               uint64_t(fields.regionCount) * sizeof(int32_t) +
+               uint64_t(fields.regionVertexCount) * sizeof(Point2f), 8);
+}
+
+SessionLogWriter::SessionLogWriter(const string& filename,
+                                   const size_t capacity)
+    : fd_(-1)
+    , mapping_(nullptr)
+    , length_(RING_OFFSET + (capacity & ~size_t(7)))
+{
+  if (length_ == RING_OFFSET) {
+    throw "Session log capacity too small";
+  }
+
+  fd_ = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    throw "Unable to create the session log";
+  }
+
+  // Allocated now, so that recording never waits for the file system to
+  // find blocks, and a full disk shows up at startup.
+  if (posix_fallocate(fd_, 0, length_) != 0) {
+    close(fd_);
+    throw "Unable to allocate the session log";
+  }
+
+  void* mapping = mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd_, 0);
+  if (mapping == MAP_FAILED) {
+    close(fd_);
+    throw "Unable to map the session log";
+  }
+
+  mapping_ = static_cast<uint8_t*>(mapping);
+  header_ = reinterpret_cast<SessionLogHeader*>(mapping_);
+  ring_ = mapping_ + RING_OFFSET;
+
+  memset(header_, 0, sizeof(*header_));
+  memcpy(header_->magic, MAGIC, sizeof(MAGIC));
+  header_->version = VERSION;
+  header_->capacity = length_ - RING_OFFSET;
+}
+
+SessionLogWriter::~SessionLogWriter()
+{
+  munmap(mapping_, length_);
+  close(fd_);
+}
+
+void SessionLogWriter::SetConfig(const string& config)
+{
+  const size_t size = min(config.size(), CONFIG_CAPACITY);
+  memcpy(mapping_ + HEADER_SIZE, config.data(), size);
+  header_->configSize = size;
+}
+
+bool SessionLogWriter::Append(const SessionFrame& frame)
+{
+  FrameHeader fields;
+  fields.sequence = frame.sequence;
+  fields.capturedNs = frame.capturedNs;
+  fields.processingMs = frame.processingMs;
+  fields.latencyMs = frame.latencyMs;
+  fields.resizeFactor = frame.resizeFactor;
+  fields.degradationLevel = frame.degradationLevel;
+  fields.rows = frame.gray.rows;
+  fields.cols = frame.gray.cols;
+  fields.vertexCount = frame.candidates.size();
+  fields.glyphCount = frame.glyphs.size();
+  fields.regionCount = frame.regions.size();
+  fields.regionVertexCount = 0;
+  for (auto& region : frame.regions) {
+    fields.regionVertexCount += region.size();
+  }
+
+  const uint64_t size = FrameSize(fields);
+  if (size > header_->capacity) {
+    return false;
+  }
+
+  // Records never wrap around the end of the ring.
+  const uint64_t left = header_->capacity - header_->tail % header_->capacity;
+  if (left < size) {
+    Reserve(left);
+    RecordHeader padding = { uint32_t(left), PaddingRecord };
+    memcpy(At(header_->tail), &padding, sizeof(padding));
+    header_->tail += left;
+  }
+
+  Reserve(size);
+  uint8_t* out = At(header_->tail);
+
+  RecordHeader record = { uint32_t(size), FrameRecord };
+  memcpy(out, &record, sizeof(record));
+  out += sizeof(record);
+
+  memcpy(out, &fields, sizeof(fields));
+  out += sizeof(fields);
+
+  for (int y = 0; y < frame.gray.rows; ++y) {
+    memcpy(out + y * frame.gray.cols, frame.gray.ptr<uint8_t>(y),
+           frame.gray.cols);
+  }
+  out += Align(uint64_t(frame.gray.rows) * frame.gray.cols, 4);
+
+  if (!frame.candidates.empty()) {
+    memcpy(out, frame.candidates.data(),
+           frame.candidates.size() * sizeof(Point2f));
+    out += frame.candidates.size() * sizeof(Point2f);
+  }
+  if (!frame.glyphs.empty()) {
+    memcpy(out, frame.glyphs.data(), frame.glyphs.size() * sizeof(LoggedGlyph));
+    out += frame.glyphs.size() * sizeof(LoggedGlyph);
+  }
+  for (auto& region : frame.regions) {
+    const int32_t count = region.size();
+    memcpy(out, &count, sizeof(count));
+    out += sizeof(count);
+  }
+  for (auto& region : frame.regions) {
+    if (!region.empty()) {
+      memcpy(out, region.data(), region.size() * sizeof(Point2f));
+      out += region.size() * sizeof(Point2f);
+    }
+  }
+
+  // Published last, a reader of a crashed session never sees half a record.
+  header_->tail += size;
+  ++header_->written;
+
+  return true;
+}
+
+void SessionLogWriter::Reserve(const uint64_t size)
+{
+  while (header_->tail + size - header_->head > header_->capacity) {
+    RecordHeader oldest;
+    memcpy(&oldest, At(header_->head), sizeof(oldest));
+    header_->head += oldest.size;
+    if (oldest.type == FrameRecord) {
+      ++header_->overwritten;
+    }
+  }
+}
+
+uint8_t* SessionLogWriter::At(const uint64_t offset)
+{
+  return ring_ + offset % header_->capacity;
+}
+
+SessionLogReader::SessionLogReader(const string& filename)
+    : mapping_(nullptr)
+    , length_(0)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw "Unable to open the session log";
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < RING_OFFSET) {
+    close(fd);
+    throw "Not a session log";
+  }
+
+  length_ = st.st_size;
+  void* mapping = mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw "Unable to map the session log";
+  }
+
+  mapping_ = static_cast<const uint8_t*>(mapping);
+  header_ = reinterpret_cast<const SessionLogHeader*>(mapping_);
+  ring_ = mapping_ + RING_OFFSET;
+  if (memcmp(header_->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header_->version != VERSION ||
+      header_->capacity != length_ - RING_OFFSET ||
+      header_->configSize > CONFIG_CAPACITY) {
+    munmap(const_cast<uint8_t*>(mapping_), length_);
+    throw "Not a session log";
+  }
+
+  position_ = header_->head;
+}
+
+SessionLogReader::~SessionLogReader()
+{
+  munmap(const_cast<uint8_t*>(mapping_), length_);
+}
+
+string SessionLogReader::Config() const
+{
+  return string(reinterpret_cast<const char*>(mapping_ + HEADER_SIZE),
+                header_->configSize);
+}
+
+bool SessionLogReader::Next(SessionFrame* frame)
+{
+  const uint64_t capacity = header_->capacity;
+  while (position_ < header_->tail) {
+    const uint8_t* in = ring_ + position_ % capacity;
+    RecordHeader record;
+    memcpy(&record, in, sizeof(record));
+    if (record.size < sizeof(record) || record.size % 8 != 0 ||
+        position_ % capacity + record.size > capacity) {
+      return false;
+    }
+    position_ += record.size;
+
+    if (record.type != FrameRecord) {
+      continue;
+    }
+
+    FrameHeader fields;
+    memcpy(&fields, in + sizeof(record), sizeof(fields));
+    if (fields.rows < 0 || fields.cols < 0 || fields.vertexCount < 0 ||
+        fields.glyphCount < 0 || fields.regionCount < 0 ||
+        fields.regionVertexCount < 0 || FrameSize(fields) != record.size) {
+      return false;
+    }
+    in += sizeof(record) + sizeof(fields);
+
+    frame->sequence = fields.sequence;
+    frame->capturedNs = fields.capturedNs;
+    frame->processingMs = fields.processingMs;
+    frame->latencyMs = fields.latencyMs;
+    frame->resizeFactor = fields.resizeFactor;
+    frame->degradationLevel = fields.degradationLevel;
+
+    frame->gray = Mat(fields.rows, fields.cols, CV_8UC1);
+    for (int y = 0; y < fields.rows; ++y) {
+      memcpy(frame->gray.ptr<uint8_t>(y), in + y * fields.cols, fields.cols);
+    }
+    in += Align(uint64_t(fields.rows) * fields.cols, 4);
+
+    frame->candidates.resize(fields.vertexCount);
+    if (fields.vertexCount > 0) {
+      memcpy(&frame->candidates[0], in, fields.vertexCount * sizeof(Point2f));
+    }
+    in += fields.vertexCount * sizeof(Point2f);
+
+    frame->glyphs.resize(fields.glyphCount);
+    if (fields.glyphCount > 0) {
+      memcpy(&frame->glyphs[0], in, fields.glyphCount * sizeof(LoggedGlyph));
+    }
+    in += fields.glyphCount * sizeof(LoggedGlyph);
+
+    const uint8_t* vertices = in + fields.regionCount * sizeof(int32_t);
+    int32_t left = fields.regionVertexCount;
+    frame->regions.resize(fields.regionCount);
+    for (auto& region : frame->regions) {
+      int32_t count;
+      memcpy(&count, in, sizeof(count));
+      in += sizeof(count);
+      if (count < 0 || count > left) {
+        return false;
+      }
+      left -= count;
+
+      region.resize(count);
+      if (count > 0) {
+        memcpy(&region[0], vertices, count * sizeof(Point2f));
+      }
+      vertices += count * sizeof(Point2f);
+    }
+
+    return true;
+  }
+
+  return false;
+}
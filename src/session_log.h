@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+// A decoded glyph as logged: its dictionary id and pose in camera
+// coordinates.
+struct LoggedGlyph
+{
+  int32_t id;
+  float x;
+  float y;
+  float angle;
+};
+
+// Everything the detection thread saw and produced for one frame.
+struct SessionFrame
+{
+  long sequence;
+  // Capture time on the steady clock, in nanoseconds.
+  int64_t capturedNs;
+  // Time spent on the frame by the worker, and from capture to result.
+  float processingMs;
+  float latencyMs;
+  float resizeFactor;
+  int32_t degradationLevel;
+  // The preprocessed frame, as fed to the BlobDetector.
+  cv::Mat gray;
+  // Four vertices per candidate, in gray frame coordinates.
+  std::vector<cv::Point2f> candidates;
+  std::vector<LoggedGlyph> glyphs;
+  // The regions detection was restricted to, in camera coordinates; none
+  // for the whole frame.
+  std::vector<std::vector<cv::Point2f>> regions;
+};
+
+// Ring log in a memory-mapped file of fixed size. The file starts with a
+// header page and the latest configuration snapshot, followed by the ring of
+// frame records. Old records are overwritten once the ring is full. The
+// mapping is shared, so what was written survives a crash of the process.
+//
+// Records are 8-byte aligned and never wrap; the space left at the end of
+// the ring is filled with a padding record instead. head and tail are
+// logical offsets that only grow, the physical one is the remainder by the
+// ring capacity.
+struct SessionLogHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t configSize;
+  uint64_t capacity;
+  uint64_t head;
+  uint64_t tail;
+  uint64_t written;
+  uint64_t overwritten;
+};
+
+class SessionLogWriter
+{
+ public:
+  // Creates or truncates the file and allocates all of it up front.
+  SessionLogWriter(const std::string& filename, const size_t capacity);
+  ~SessionLogWriter();
+
+  // Keeps the configuration the frames are recorded with. Truncated to the
+  // space reserved for it.
+  void SetConfig(const std::string& config);
+  // Returns false if the frame doesn't fit into the ring at all.
+  bool Append(const SessionFrame& frame);
+
+ private:
+  SessionLogWriter(const SessionLogWriter&);
+  SessionLogWriter& operator=(const SessionLogWriter&);
+
+  // Drops the oldest records until size more bytes fit behind tail.
+  void Reserve(const uint64_t size);
+  uint8_t* At(const uint64_t offset);
+
+  int fd_;
+  uint8_t* mapping_;
+  size_t length_;
+  SessionLogHeader* header_;
+  uint8_t* ring_;
+};
+
+class SessionLogReader
+{
+ public:
+  SessionLogReader(const std::string& filename);
+  ~SessionLogReader();
+
+  std::string Config() const;
+  // Reads the frames from the oldest one on. Returns false after the last.
+  bool Next(SessionFrame* frame);
+
+ private:
+  SessionLogReader(const SessionLogReader&);
+  SessionLogReader& operator=(const SessionLogReader&);
+
+  const uint8_t* mapping_;
+  size_t length_;
+  const SessionLogHeader* header_;
+  const uint8_t* ring_;
+  uint64_t position_;
+};
@@ -0,0 +1,53 @@
+#include "session_recorder.h"
+
+#include "configuration.h"
+
+using namespace std;
+
+// Frames waiting to be written; the detector drops frames beyond that.
+static const size_t QUEUE_CAPACITY = 8;
+
+SessionRecorder::SessionRecorder(const string& filename, const size_t capacity)
+    : log_(filename, capacity)
+    , queue_(QUEUE_CAPACITY)
+{
+  thread_ = thread(Writer, this);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+}
+
+void SessionRecorder::Stop()
+{
+  queue_.Close();
+  thread_.join();
+}
+
+bool SessionRecorder::Publish(SessionFrame* frame)
+{
+  return queue_.TryPush(frame);
+}
+
+long SessionRecorder::Dropped()
+{
+  return queue_.Dropped();
+}
+
+void SessionRecorder::Writer(SessionRecorder* instance)
+{
+  // The configuration is reloaded while running; the log keeps the latest
+  // one, compared here rather than on the detection thread.
+  string config;
+  SessionFrame frame;
+  while (instance->queue_.Pop(&frame)) {
+    const string current = Configuration::Instance().Dump();
+    if (current != config) {
+      config = current;
+      instance->log_.SetConfig(config);
+    }
+
+    instance->log_.Append(frame);
+    frame = SessionFrame();
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <thread>
+
+#include "bounded_queue.h"
+#include "session_log.h"
+
+// Records the frames the detector processed to a SessionLogWriter on its own
+// thread, so that field incidents can be replayed with tools/replay. The
+// detector only hands frames over and never waits for the disk; frames the
+// writer can't keep up with are dropped.
+class SessionRecorder
+{
+ public:
+  SessionRecorder(const std::string& filename, const size_t capacity);
+  ~SessionRecorder();
+
+  void Stop();
+  // Takes over the frame unless the writer is still busy with previous
+  // ones, in which case the frame is dropped.
+  bool Publish(SessionFrame* frame);
+  long Dropped();
+
+ private:
+  static void Writer(SessionRecorder* instance);
+
+  SessionLogWriter log_;
+  BoundedQueue<SessionFrame> queue_;
+  std::thread thread_;
+};
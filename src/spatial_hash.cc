@@ -0,0 +1,121 @@
+#include "spatial_hash.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+SpatialHash::SpatialHash(const float cellSize)
+    : inverseCellSize_(1.0f / cellSize)
+    , stamp_(0)
+{
+}
+
+SpatialHash::~SpatialHash()
+{
+}
+
+void SpatialHash::Update(const int id, const Aabb& bounds)
+{
+  if (id >= static_cast<int>(ranges_.size())) {
+    ranges_.resize(id + 1);
+    present_.resize(id + 1, false);
+    stamps_.resize(id + 1, 0);
+  }
+
+  const CellRange range = Cells(bounds);
+  if (present_[id]) {
+    const CellRange& old = ranges_[id];
+    if (old.x0 == range.x0 && old.y0 == range.y0 &&
+        old.x1 == range.x1 && old.y1 == range.y1) {
+      return;
+    }
+    Erase(id, old);
+  }
+
+  Insert(id, range);
+  ranges_[id] = range;
+  present_[id] = true;
+}
+
+void SpatialHash::Remove(const int id)
+{
+  if (id < static_cast<int>(present_.size()) && present_[id]) {
+    Erase(id, ranges_[id]);
+    present_[id] = false;
+  }
+}
+
+void SpatialHash::Query(const Aabb& bounds, vector<int>* ids)
+{
+  // Items spanning several cells are seen more than once; the stamp filters
+  // out the repeats without clearing anything between queries.
+  if (++stamp_ == 0) {
+    fill(stamps_.begin(), stamps_.end(), 0);
+    stamp_ = 1;
+  }
+
+  const CellRange range = Cells(bounds);
+  for (int cy = range.y0; cy <= range.y1; ++cy) {
+    for (int cx = range.x0; cx <= range.x1; ++cx) {
+      auto it = cells_.find(Key(cx, cy));
+      if (it == cells_.end()) {
+        continue;
+      }
+
+      for (int id : it->second) {
+        if (stamps_[id] != stamp_) {
+          stamps_[id] = stamp_;
+          ids->push_back(id);
+        }
+      }
+    }
+  }
+}
+
+SpatialHash::CellRange SpatialHash::Cells(const Aabb& bounds) const
+{
+  CellRange range;
+  range.x0 = static_cast<int>(floor(bounds.x0 * inverseCellSize_));
+  range.y0 = static_cast<int>(floor(bounds.y0 * inverseCellSize_));
+  range.x1 = static_cast<int>(floor(bounds.x1 * inverseCellSize_));
+  range.y1 = static_cast<int>(floor(bounds.y1 * inverseCellSize_));
+
+  return range;
+}
+
+void SpatialHash::Insert(const int id, const CellRange& range)
+{
+  for (int cy = range.y0; cy <= range.y1; ++cy) {
+    for (int cx = range.x0; cx <= range.x1; ++cx) {
+      cells_[Key(cx, cy)].push_back(id);
+    }
+  }
+}
+
+void SpatialHash::Erase(const int id, const CellRange& range)
+{
+  for (int cy = range.y0; cy <= range.y1; ++cy) {
+    for (int cx = range.x0; cx <= range.x1; ++cx) {
+      auto it = cells_.find(Key(cx, cy));
+      if (it == cells_.end()) {
+        continue;
+      }
+
+      // Order inside a cell doesn't matter, swap with the last one. Empty
+      // cells are kept so bricks moving back and forth don't reallocate.
+      vector<int>& cell = it->second;
+      auto item = find(cell.begin(), cell.end(), id);
+      if (item != cell.end()) {
+        *item = cell.back();
+        cell.pop_back();
+      }
+    }
+  }
+}
+
+uint64_t SpatialHash::Key(const int cx, const int cy)
+{
+  return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+         static_cast<uint32_t>(cy);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct Aabb
+{
+  float x0, y0, x1, y1;
+};
+
+// Uniform grid over an unbounded plane, stored sparsely. Items are kept in
+// every cell their bounds overlap; moving an item only touches the grid when
+// the set of covered cells changes.
+class SpatialHash
+{
+ public:
+  SpatialHash(const float cellSize);
+  ~SpatialHash();
+
+  // Inserts the item or moves it to its new bounds.
+  void Update(const int id, const Aabb& bounds);
+  void Remove(const int id);
+  // Appends every item sharing a cell with bounds, each one only once.
+  void Query(const Aabb& bounds, std::vector<int>* ids);
+
+ private:
+  struct CellRange
+  {
+    int x0, y0, x1, y1;
+  };
+
+  CellRange Cells(const Aabb& bounds) const;
+  void Insert(const int id, const CellRange& range);
+  void Erase(const int id, const CellRange& range);
+  static uint64_t Key(const int cx, const int cy);
+
+  const float inverseCellSize_;
+  std::unordered_map<uint64_t, std::vector<int>> cells_;
+  // Per item: covered cells, whether it is in the grid and the last query
+  // it was reported by.
+  std::vector<CellRange> ranges_;
+  std::vector<bool> present_;
+  std::vector<unsigned> stamps_;
+  unsigned stamp_;
+};
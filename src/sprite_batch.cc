@@ -0,0 +1,72 @@
+#include "sprite_batch.h"
+
+#include <cmath>
+
+using namespace std;
+
+static const double DEGREES_TO_RADIANS = M_PI / 180.0;
+
+SpriteBatch::SpriteBatch()
+{
+}
+
+SpriteBatch::~SpriteBatch()
+{
+}
+
+void SpriteBatch::Add(const AtlasSprite& sprite, const float x, const float y,
+                      const double angle)
+{
+  const float halfWidth = sprite.rect.w * 0.5f;
+  const float halfHeight = sprite.rect.h * 0.5f;
+  const float cx = x + halfWidth;
+  const float cy = y + halfHeight;
+
+  const float c = cos(angle * DEGREES_TO_RADIANS);
+  const float s = sin(angle * DEGREES_TO_RADIANS);
+
+  // Corners relative to the center: top-left, top-right, bottom-right and
+  // bottom-left, with their matching texture coordinates.
+  const float dx[4] = { -halfWidth, halfWidth, halfWidth, -halfWidth };
+  const float dy[4] = { -halfHeight, -halfHeight, halfHeight, halfHeight };
+  const float u[4] = { sprite.u0, sprite.u1, sprite.u1, sprite.u0 };
+  const float v[4] = { sprite.v0, sprite.v0, sprite.v1, sprite.v1 };
+
+  const int base = vertices_.size();
+  for (int i = 0; i < 4; ++i) {
+    SDL_Vertex vertex;
+    vertex.position.x = cx + dx[i] * c - dy[i] * s;
+    vertex.position.y = cy + dx[i] * s + dy[i] * c;
+    vertex.color.r = 255;
+    vertex.color.g = 255;
+    vertex.color.b = 255;
+    vertex.color.a = 255;
+    vertex.tex_coord.x = u[i];
+    vertex.tex_coord.y = v[i];
+    vertices_.push_back(vertex);
+  }
+
+  indices_.push_back(base);
+  indices_.push_back(base + 1);
+  indices_.push_back(base + 2);
+  indices_.push_back(base);
+  indices_.push_back(base + 2);
+  indices_.push_back(base + 3);
+}
+
+void SpriteBatch::Flush(SDL_Renderer* renderer, SDL_Texture* atlas)
+{
+  if (!indices_.empty()) {
+    SDL_RenderGeometry(renderer, atlas, vertices_.data(), vertices_.size(),
+                       indices_.data(), indices_.size());
+  }
+
+  // Keep the capacity; the batch is refilled every frame.
+  vertices_.clear();
+  indices_.clear();
+}
+
+size_t SpriteBatch::Size() const
+{
+  return indices_.size() / 6;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "SDL.h"
+
+#include "texture_atlas.h"
+
+// Collects textured quads that share one atlas texture and submits them to
+// the renderer in a single SDL_RenderGeometry call.
+class SpriteBatch
+{
+ public:
+  SpriteBatch();
+  ~SpriteBatch();
+
+  // Queues a sprite with its top-left corner at (x, y), rotated clockwise by
+  // angle degrees around its center, the same as SDL_RenderCopyEx.
+  void Add(const AtlasSprite& sprite, const float x, const float y,
+           const double angle);
+  // Draws everything queued since the last flush and empties the batch.
+  void Flush(SDL_Renderer* renderer, SDL_Texture* atlas);
+  size_t Size() const;
+
+ private:
+  std::vector<SDL_Vertex> vertices_;
+  std::vector<int> indices_;
+};
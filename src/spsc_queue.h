@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free ring between exactly one producer and one consumer thread. The
+// producer never waits: items pushed while the ring is full are refused.
+// The capacity is rounded up to a power of two.
+template <typename T>
+class SpscQueue
+{
+ public:
+  SpscQueue(const size_t capacity)
+      : head_(0)
+      , tail_(0)
+  {
+    size_t size = 1;
+    while (size < capacity) {
+      size *= 2;
+    }
+    items_.resize(size);
+    mask_ = size - 1;
+  }
+
+  // Producer only. Returns false, leaving the queue as it was, when full.
+  bool TryPush(const T& item)
+  {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) {
+      return false;
+    }
+
+    items_[tail & mask_] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  // Consumer only. Returns false when there is nothing to pop.
+  bool TryPop(T* item)
+  {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    *item = items_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+
+    return true;
+  }
+
+ private:
+  SpscQueue(const SpscQueue&);
+  SpscQueue& operator=(const SpscQueue&);
+
+  std::vector<T> items_;
+  size_t mask_;
+  // On separate cache lines, so that the two threads don't keep stealing
+  // each other's line.
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+};
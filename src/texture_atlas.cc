@@ -0,0 +1,175 @@
+#include "texture_atlas.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <dirent.h>
+
+#include "SDL_image.h"
+
+using namespace std;
+
+// Sprites are packed in shelves of this width, unless one is even wider.
+static const int SHELF_WIDTH = 2048;
+// Empty pixels around each sprite so filtering doesn't bleed neighbours in.
+static const int PADDING = 1;
+
+struct PendingSprite
+{
+  string name;
+  SDL_Surface* surface;
+  SDL_Rect rect;
+};
+
+static bool TallerFirst(const PendingSprite& lhs, const PendingSprite& rhs)
+{
+  return lhs.surface->h > rhs.surface->h;
+}
+
+static bool HasPngExtension(const string& file)
+{
+  const string extension = ".png";
+  return file.size() > extension.size() &&
+         file.compare(file.size() - extension.size(), extension.size(),
+                      extension) == 0;
+}
+
+TextureAtlas::TextureAtlas()
+    : texture_(nullptr)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+  Clear();
+}
+
+void TextureAtlas::Clear()
+{
+  if (texture_ != nullptr) {
+    SDL_DestroyTexture(texture_);
+    texture_ = nullptr;
+  }
+  sprites_.clear();
+}
+
+bool TextureAtlas::Load(const string& directory, SDL_Renderer* renderer)
+{
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) {
+    cout << "Unable to open " << directory << endl;
+    return false;
+  }
+
+  vector<PendingSprite> pending;
+  for (dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+    const string file = entry->d_name;
+    if (!HasPngExtension(file)) {
+      continue;
+    }
+
+    SDL_Surface* loaded = IMG_Load((directory + "/" + file).c_str());
+    if (loaded == nullptr) {
+      cout << "IMG_Load error: " << SDL_GetError() << endl;
+      continue;
+    }
+
+    PendingSprite sprite;
+    sprite.name = file.substr(0, file.size() - 4);
+    sprite.surface =
+        SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(loaded);
+    if (sprite.surface != nullptr) {
+      pending.push_back(sprite);
+    }
+  }
+  closedir(dir);
+
+  if (pending.empty()) {
+    return false;
+  }
+
+  // Shelf packing: place the tallest sprites first, left to right, and open
+  // a new shelf whenever the current one is full.
+  sort(pending.begin(), pending.end(), TallerFirst);
+
+  int width = 0;
+  for (auto& sprite : pending) {
+    width = max(width, sprite.surface->w + 2 * PADDING);
+  }
+  width = max(width, SHELF_WIDTH);
+
+  int x = 0, y = 0, shelfHeight = 0, usedWidth = 0;
+  for (auto& sprite : pending) {
+    const int w = sprite.surface->w + 2 * PADDING;
+    const int h = sprite.surface->h + 2 * PADDING;
+    if (x + w > width) {
+      x = 0;
+      y += shelfHeight;
+      shelfHeight = 0;
+    }
+
+    sprite.rect.x = x + PADDING;
+    sprite.rect.y = y + PADDING;
+    sprite.rect.w = sprite.surface->w;
+    sprite.rect.h = sprite.surface->h;
+
+    x += w;
+    usedWidth = max(usedWidth, x);
+    shelfHeight = max(shelfHeight, h);
+  }
+  const int height = y + shelfHeight;
+
+  SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(
+      0, usedWidth, height, 32, SDL_PIXELFORMAT_RGBA32);
+  if (atlas == nullptr) {
+    cout << "SDL_CreateRGBSurfaceWithFormat error: " << SDL_GetError() << endl;
+    for (auto& sprite : pending) {
+      SDL_FreeSurface(sprite.surface);
+    }
+    return false;
+  }
+  SDL_FillRect(atlas, nullptr, 0);
+
+  Clear();
+  for (auto& sprite : pending) {
+    // Copy the pixels as they are, alpha included.
+    SDL_SetSurfaceBlendMode(sprite.surface, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(sprite.surface, nullptr, atlas, &sprite.rect);
+    SDL_FreeSurface(sprite.surface);
+
+    AtlasSprite& entry = sprites_[sprite.name];
+    entry.rect = sprite.rect;
+    entry.u0 = sprite.rect.x / static_cast<float>(usedWidth);
+    entry.v0 = sprite.rect.y / static_cast<float>(height);
+    entry.u1 = (sprite.rect.x + sprite.rect.w) / static_cast<float>(usedWidth);
+    entry.v1 = (sprite.rect.y + sprite.rect.h) / static_cast<float>(height);
+  }
+
+  texture_ = SDL_CreateTextureFromSurface(renderer, atlas);
+  SDL_FreeSurface(atlas);
+
+  if (texture_ == nullptr) {
+    cout << "SDL_CreateTextureFromSurface error: " << SDL_GetError() << endl;
+    return false;
+  }
+  SDL_SetTextureBlendMode(texture_, SDL_BLENDMODE_BLEND);
+
+  return true;
+}
+
+SDL_Texture* TextureAtlas::Texture() const
+{
+  return texture_;
+}
+
+const AtlasSprite* TextureAtlas::Find(const string& name) const
+{
+  auto it = sprites_.find(name);
+  if (it == sprites_.end()) {
+    return nullptr;
+  }
+
+  return &it->second;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "SDL.h"
+
+struct AtlasSprite
+{
+  // Location of the sprite inside the atlas, in pixels.
+  SDL_Rect rect;
+  // Same location in normalized texture coordinates.
+  float u0, v0, u1, v1;
+};
+
+// Packs a set of images into a single texture so that every sprite can be
+// drawn with the same texture bound.
+class TextureAtlas
+{
+ public:
+  TextureAtlas();
+  ~TextureAtlas();
+
+  // Packs every PNG file in directory. Sprites are named after their file
+  // without the extension, e.g. "resources/ball.png" becomes "ball".
+  bool Load(const std::string& directory, SDL_Renderer* renderer);
+  // Destroys the texture; it has to happen before its renderer goes away.
+  void Clear();
+
+  SDL_Texture* Texture() const;
+  // Returns nullptr when there is no sprite with the given name.
+  const AtlasSprite* Find(const std::string& name) const;
+
+ private:
+  SDL_Texture* texture_;
+  std::map<std::string, AtlasSprite> sprites_;
+
+  // Hiding any copy construction behavior.
+  TextureAtlas(const TextureAtlas& atlas);
+  TextureAtlas& operator=(const TextureAtlas& atlas);
+};
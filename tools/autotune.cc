@@ -0,0 +1,451 @@
+// Searches the detector parameters of configuration.txt for the best
+// trade-offs between throughput and recall on a labelled corpus.
+//
+//    ./autotune.bin <corpus.txt> [output] [configurations] [jobs]
+//
+// Every line of the corpus names an image and the glyphs on it, by their
+// names in the dictionary, e.g.
+//
+//    frames/desk_01.png basic identity identity
+//
+// Starting from configuration.txt, it samples configurations at random and
+// narrows them down by successive halving: every round evaluates the
+// survivors on twice as many frames as the previous one and keeps the
+// better half, ranked by Pareto fronts of frames per second against recall.
+// The last round runs on the whole corpus. Evaluations are spread over
+// forked worker processes, one per core by default; the frame rates are
+// those of a loaded machine, pass 1 job for the most accurate ones.
+//
+// Prints the final Pareto front and writes configuration.txt with the values
+// of the fastest configuration on it whose recall is within RECALL_SLACK of
+// the best one to output (autotuned_configuration.txt).
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "configuration.h"
+#include "frame_processor.h"
+#include "glyph_dictionary.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static const char* DICTIONARY = "glyph_schema.txt";
+static const int DEFAULT_CONFIGURATIONS = 64;
+// Rounds of halving before the one on the whole corpus, and the least
+// number of frames the first round runs on.
+static const int HALVING_ROUNDS = 3;
+static const int MIN_ROUND_FRAMES = 8;
+// Recall the written configuration may give up for speed.
+static const double RECALL_SLACK = 0.01;
+
+// A knob and the values it is searched over: an interval, sampled
+// uniformly, or a list of choices.
+struct Parameter
+{
+  string name;
+  double min;
+  double max;
+  bool integer;
+  vector<string> choices;
+};
+
+struct Result
+{
+  int candidate;
+  double fps;
+  double recall;
+  double precision;
+};
+
+struct Frame
+{
+  Mat gray;
+  // Expected glyph ids, with repetitions.
+  vector<int> glyphs;
+};
+
+static Parameter Interval(const string& name, const double min,
+                          const double max, const bool integer)
+{
+  Parameter parameter = { name, min, max, integer, vector<string>() };
+  return parameter;
+}
+
+static Parameter Choices(const string& name, const vector<string>& choices)
+{
+  Parameter parameter = { name, 0, 0, false, choices };
+  return parameter;
+}
+
+static vector<Parameter> SearchSpace()
+{
+  vector<Parameter> space;
+  space.push_back(Choices("frame_resize_factor",
+                          { "1", "0.75", "0.5", "0.375", "0.25" }));
+  space.push_back(Choices("segmentation_mode", { "canny", "threshold" }));
+  space.push_back(Choices("threshold_window_size",
+                          { "11", "15", "21", "31", "41", "51" }));
+  space.push_back(Interval("threshold_offset", 2, 20, true));
+  space.push_back(Choices("canny_blur_kernel_size", { "1", "3", "5" }));
+  space.push_back(Interval("canny_low_threshold", 5, 80, true));
+  space.push_back(Interval("canny_high_threshold", 40, 250, true));
+  space.push_back(Choices("canny_kernel_size", { "3", "5" }));
+  space.push_back(Interval("corner_harris_block_size", 3, 11, true));
+  space.push_back(Choices("corner_harris_aperture_size", { "3", "5", "7" }));
+  space.push_back(Interval("corner_harris_free_coefficient", 0.01, 0.1, false));
+  space.push_back(Interval("corner_harris_threshold", 50, 220, true));
+  space.push_back(Choices("corner_detection_mode", { "per_blob", "shared" }));
+  space.push_back(Interval("corner_response_threshold", 0.2, 0.8, false));
+  space.push_back(Interval("blob_min_norm_bbox_size", 0.01, 0.1, false));
+  space.push_back(Interval("blob_max_norm_bbox_size", 0.2, 0.6, false));
+  space.push_back(Interval("blob_max_aspect_ratio", 2, 6, false));
+  space.push_back(Interval("blob_min_fill_ratio", 0, 0.3, false));
+  space.push_back(Interval("blob_min_solidity", 0.3, 0.9, false));
+  space.push_back(Interval("vertices_merging_distance", 2, 8, false));
+  space.push_back(Interval("snap_vertices_window_size", 6, 24, true));
+  space.push_back(Interval("snap_vertices_search_factor", 0.1, 0.5, false));
+
+  return space;
+}
+
+static string Sample(const Parameter& parameter)
+{
+  if (!parameter.choices.empty()) {
+    return parameter.choices[rand() % parameter.choices.size()];
+  }
+
+  const double value = parameter.min +
+      (parameter.max - parameter.min) * rand() / RAND_MAX;
+  stringstream ss;
+  if (parameter.integer) {
+    ss << int(value + 0.5);
+  } else {
+    ss << value;
+  }
+  return ss.str();
+}
+
+static vector<Frame> ReadCorpus(const string& filename,
+                                const GlyphDictionary& dictionary)
+{
+  map<string, int> ids;
+  for (size_t id = 0; id < dictionary.Count(); ++id) {
+    ids[dictionary.Name(id)] = id;
+  }
+
+  ifstream file(filename.c_str());
+  if (!file) {
+    throw "Unable to open the corpus";
+  }
+
+  vector<Frame> frames;
+  string line;
+  while (getline(file, line)) {
+    stringstream ss(line);
+    string image;
+    if (!(ss >> image) || image[0] == '#') {
+      continue;
+    }
+
+    Frame frame;
+    frame.gray = imread(image, CV_LOAD_IMAGE_GRAYSCALE);
+    if (frame.gray.empty()) {
+      cerr << "Unable to read " << image << endl;
+      throw "Invalid corpus";
+    }
+
+    string name;
+    while (ss >> name) {
+      auto it = ids.find(name);
+      if (it == ids.end()) {
+        cerr << "No glyph " << name << " in " << DICTIONARY << endl;
+        throw "Invalid corpus";
+      }
+      frame.glyphs.push_back(it->second);
+    }
+    frames.push_back(frame);
+  }
+
+  return frames;
+}
+
+// Runs the detector over the first count frames.
+static Result Evaluate(const vector<Parameter>& space,
+                       const vector<string>& values,
+                       const vector<Frame>& frames, const size_t count,
+                       FrameProcessor* processor)
+{
+  Configuration& config = Configuration::Instance();
+  for (size_t i = 0; i < space.size(); ++i) {
+    config.Set(space[i].name, values[i]);
+  }
+  const float factor = config.ReadFloat("frame_resize_factor");
+
+  vector<Glyph> glyphs;
+  long expected = 0, found = 0, matched = 0;
+  double seconds = 0;
+  for (size_t f = 0; f < count; ++f) {
+    const Clock::time_point start = Clock::now();
+
+    processor->Process(frames[f].gray, factor, &glyphs);
+
+    seconds += chrono::duration<double>(Clock::now() - start).count();
+
+    // Every expected glyph is matched by at most one detection of its id.
+    vector<int> left;
+    for (auto& glyph : glyphs) {
+      left.push_back(glyph.Id());
+    }
+    for (int id : frames[f].glyphs) {
+      auto it = find(left.begin(), left.end(), id);
+      if (it != left.end()) {
+        left.erase(it);
+        ++matched;
+      }
+    }
+    expected += frames[f].glyphs.size();
+    found += glyphs.size();
+  }
+
+  Result result;
+  result.candidate = -1;
+  result.fps = seconds > 0 ? count / seconds : 0;
+  result.recall = expected ? double(matched) / expected : 1.0;
+  result.precision = found ? double(matched) / found : 1.0;
+  return result;
+}
+
+// Evaluates the candidates in forked workers, each taking every jobs-th one.
+static vector<Result> EvaluateAll(const vector<Parameter>& space,
+                                  const vector<vector<string>>& candidates,
+                                  const vector<int>& indices,
+                                  const vector<Frame>& frames,
+                                  const size_t count, const int jobs)
+{
+  vector<int> pipes;
+  vector<pid_t> workers;
+  for (int job = 0; job < jobs; ++job) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      throw "Unable to create a pipe";
+    }
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+      throw "Unable to fork a worker";
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      FrameProcessor processor(DICTIONARY);
+      for (size_t i = job; i < indices.size(); i += jobs) {
+        Result result = Evaluate(space, candidates[indices[i]], frames, count,
+                                 &processor);
+        result.candidate = indices[i];
+        if (write(fds[1], &result, sizeof(result)) != sizeof(result)) {
+          _exit(1);
+        }
+      }
+      _exit(0);
+    }
+
+    close(fds[1]);
+    pipes.push_back(fds[0]);
+    workers.push_back(pid);
+  }
+
+  vector<Result> results;
+  for (size_t job = 0; job < pipes.size(); ++job) {
+    Result result;
+    while (read(pipes[job], &result, sizeof(result)) == sizeof(result)) {
+      results.push_back(result);
+    }
+    close(pipes[job]);
+    waitpid(workers[job], nullptr, 0);
+  }
+
+  if (results.size() != indices.size()) {
+    throw "A worker failed";
+  }
+  return results;
+}
+
+static bool Dominates(const Result& lhs, const Result& rhs)
+{
+  return lhs.fps >= rhs.fps && lhs.recall >= rhs.recall &&
+         (lhs.fps > rhs.fps || lhs.recall > rhs.recall);
+}
+
+// Splits the results into successive Pareto fronts, the best one first.
+static vector<vector<Result>> Fronts(vector<Result> results)
+{
+  vector<vector<Result>> fronts;
+  while (!results.empty()) {
+    vector<Result> front, rest;
+    for (auto& result : results) {
+      bool dominated = false;
+      for (auto& other : results) {
+        dominated |= Dominates(other, result);
+      }
+      (dominated ? rest : front).push_back(result);
+    }
+    fronts.push_back(front);
+    results.swap(rest);
+  }
+
+  return fronts;
+}
+
+// Copies the configuration file with the values of the candidate.
+static void WriteConfiguration(const string& filename,
+                               const vector<Parameter>& space,
+                               const vector<string>& values)
+{
+  map<string, string> tuned;
+  for (size_t i = 0; i < space.size(); ++i) {
+    tuned[space[i].name] = values[i];
+  }
+
+  ifstream in("configuration.txt");
+  ofstream out(filename.c_str());
+  string line;
+  while (getline(in, line)) {
+    stringstream ss(line);
+    string name;
+    ss >> name;
+    auto it = tuned.find(name);
+    out << (it != tuned.end() ? name + " " + it->second : line) << endl;
+  }
+  if (!out) {
+    throw "Unable to write the configuration";
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    cerr << "usage: " << argv[0]
+         << " <corpus.txt> [output] [configurations] [jobs]" << endl;
+    return 1;
+  }
+
+  const string output = argc > 2 ? argv[2] : "autotuned_configuration.txt";
+  const int configurations =
+      max(argc > 3 ? atoi(argv[3]) : DEFAULT_CONFIGURATIONS, 1);
+  const int jobs = max(argc > 4 ? atoi(argv[4])
+                                : int(sysconf(_SC_NPROCESSORS_ONLN)), 1);
+
+  try {
+    Configuration& config = Configuration::Instance();
+    config.LoadOnce("configuration.txt");
+    // Decodes must not be served from the previous image of the corpus.
+    config.Set("decode_cache_size", "0");
+
+    vector<Frame> frames = ReadCorpus(argv[1], GlyphDictionary(DICTIONARY));
+    if (frames.empty()) {
+      throw "Empty corpus";
+    }
+
+    // Rounds take a prefix of the corpus, which should be a fair sample.
+    srand(1);
+    random_shuffle(frames.begin(), frames.end());
+
+    // The current configuration competes as the first candidate.
+    const vector<Parameter> space = SearchSpace();
+    vector<vector<string>> candidates;
+    vector<string> current;
+    for (auto& parameter : space) {
+      current.push_back(config.ReadString(parameter.name));
+    }
+    candidates.push_back(current);
+    while (int(candidates.size()) < configurations) {
+      vector<string> values;
+      for (auto& parameter : space) {
+        values.push_back(Sample(parameter));
+      }
+      candidates.push_back(values);
+    }
+
+    vector<int> survivors;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      survivors.push_back(i);
+    }
+
+    size_t count = max(min(frames.size(), size_t(MIN_ROUND_FRAMES)),
+                       frames.size() >> HALVING_ROUNDS);
+    vector<Result> results;
+    while (true) {
+      results = EvaluateAll(space, candidates, survivors, frames, count, jobs);
+      cout << survivors.size() << " configurations on " << count << " frames"
+           << endl;
+      if (count == frames.size()) {
+        break;
+      }
+
+      // The better half, whole fronts first, by recall within the last.
+      survivors.clear();
+      const size_t keep = max(results.size() / 2, size_t(1));
+      for (auto& front : Fronts(results)) {
+        sort(front.begin(), front.end(),
+             [](const Result& lhs, const Result& rhs) {
+               return lhs.recall > rhs.recall;
+             });
+        for (size_t i = 0; i < front.size() && survivors.size() < keep; ++i) {
+          survivors.push_back(front[i].candidate);
+        }
+      }
+      count = min(count * 2, frames.size());
+    }
+
+    vector<Result> front = Fronts(results)[0];
+    sort(front.begin(), front.end(), [](const Result& lhs, const Result& rhs) {
+      return lhs.fps > rhs.fps;
+    });
+
+    double bestRecall = 0;
+    for (auto& result : front) {
+      bestRecall = max(bestRecall, result.recall);
+    }
+
+    const Result* chosen = nullptr;
+    cout << "fps,recall,precision,changes" << endl;
+    for (auto& result : front) {
+      if (!chosen && result.recall >= bestRecall - RECALL_SLACK) {
+        chosen = &result;
+      }
+
+      cout << result.fps << "," << result.recall << "," << result.precision
+           << ",";
+      const vector<string>& values = candidates[result.candidate];
+      for (size_t i = 0; i < space.size(); ++i) {
+        if (values[i] != current[i]) {
+          cout << " " << space[i].name << "=" << values[i];
+        }
+      }
+      cout << (result.candidate == 0 ? " (current)" : "") << endl;
+    }
+
+    WriteConfiguration(output, space, candidates[chosen->candidate]);
+    cout << "Wrote the configuration at " << chosen->fps << " fps and "
+         << chosen->recall << " recall to " << output << endl;
+  } catch (const char* error) {
+    cerr << error << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,209 @@
+// Detects the glyphs in every image of a directory, e.g. frames exported
+// from recorded footage, spreading the images over all cores.
+//
+//    ./batch_detect.bin <directory> [jobs] [resize_factor] > glyphs.jsonl
+//
+// Writes one JSON line per image, in the order the images finish in:
+//
+//    {"image":"frame_0001.jpg","glyphs":[{"id":0,"name":"basic",
+//     "x":321.5,"y":240.25,"angle":12.5}]}
+//
+// Poses are in image coordinates. JPEG files are decoded straight to gray
+// at the working scale, like the camera path does. The factor defaults to
+// frame_resize_factor. Prints the throughput to stderr.
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "configuration.h"
+#include "frame_processor.h"
+#include "glyph_dictionary.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static const char* DICTIONARY = "glyph_schema.txt";
+static const char* EXTENSIONS[] = { ".jpg", ".jpeg", ".png", ".bmp" };
+
+struct Batch
+{
+  string directory;
+  vector<string> images;
+  float factor;
+  const GlyphDictionary* dictionary;
+  // Index of the next image to process.
+  atomic<size_t> next;
+  mutex outputMutex;
+  atomic<long> failed;
+  atomic<long> glyphs;
+};
+
+static bool IsImage(const string& name)
+{
+  string lower = name;
+  transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+  for (const char* extension : EXTENSIONS) {
+    const string suffix = extension;
+    if (lower.size() > suffix.size() &&
+        lower.compare(lower.size() - suffix.size(), suffix.size(),
+                      suffix) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static vector<string> ListImages(const string& directory)
+{
+  DIR* dir = opendir(directory.c_str());
+  if (!dir) {
+    throw "Unable to open the directory";
+  }
+
+  vector<string> images;
+  while (dirent* entry = readdir(dir)) {
+    if (IsImage(entry->d_name)) {
+      images.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+
+  sort(images.begin(), images.end());
+  return images;
+}
+
+static string Quoted(const string& text)
+{
+  string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+
+  return quoted + "\"";
+}
+
+// Reads a file whole. JPEG images stay encoded, in the single row layout
+// FrameProcessor decodes itself; anything else is decoded to BGR here.
+static Mat ReadImage(const string& filename)
+{
+  ifstream file(filename.c_str(), ios::binary);
+  vector<uchar> bytes((istreambuf_iterator<char>(file)),
+                      istreambuf_iterator<char>());
+  if (bytes.size() < 2) {
+    return Mat();
+  }
+  if (bytes[0] == 0xff && bytes[1] == 0xd8) {
+    return Mat(bytes, true).reshape(1, 1);
+  }
+
+  return imdecode(bytes, IMREAD_COLOR);
+}
+
+static void Worker(Batch* batch)
+{
+  FrameProcessor processor(DICTIONARY);
+  vector<Glyph> glyphs;
+
+  for (size_t i = batch->next++; i < batch->images.size();
+       i = batch->next++) {
+    const string& name = batch->images[i];
+    const Mat image = ReadImage(batch->directory + "/" + name);
+
+    stringstream line;
+    line << "{\"image\":" << Quoted(name);
+    if (image.empty() || !processor.Process(image, batch->factor, &glyphs)) {
+      line << ",\"error\":\"unreadable\"}";
+      ++batch->failed;
+    } else {
+      line << ",\"glyphs\":[";
+      for (size_t g = 0; g < glyphs.size(); ++g) {
+        const Glyph& glyph = glyphs[g];
+        line << (g ? "," : "") << "{\"id\":" << glyph.Id()
+             << ",\"name\":" << Quoted(batch->dictionary->Name(glyph.Id()))
+             << ",\"x\":" << glyph.Center().x
+             << ",\"y\":" << glyph.Center().y
+             << ",\"angle\":" << glyph.Angle() << "}";
+      }
+      line << "]}";
+      batch->glyphs += glyphs.size();
+    }
+
+    lock_guard<mutex> lock(batch->outputMutex);
+    cout << line.str() << "\n";
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    cerr << "usage: " << argv[0] << " <directory> [jobs] [resize_factor]"
+         << endl;
+    return 1;
+  }
+
+  const int jobs = max(argc > 2 ? atoi(argv[2])
+                                : int(sysconf(_SC_NPROCESSORS_ONLN)), 1);
+
+  try {
+    Configuration& config = Configuration::Instance();
+    config.LoadOnce("configuration.txt");
+    // Images are processed out of order, the decode cache would only
+    // match quads of unrelated frames.
+    config.Set("decode_cache_size", "0");
+
+    const GlyphDictionary dictionary(DICTIONARY);
+
+    Batch batch;
+    batch.directory = argv[1];
+    batch.images = ListImages(batch.directory);
+    batch.factor = argc > 3 ? atof(argv[3])
+                            : config.ReadFloat("frame_resize_factor");
+    batch.dictionary = &dictionary;
+    batch.next = 0;
+    batch.failed = 0;
+    batch.glyphs = 0;
+
+    const Clock::time_point start = Clock::now();
+    vector<thread> workers;
+    for (int job = 0; job < jobs; ++job) {
+      workers.push_back(thread(Worker, &batch));
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    cout.flush();
+    const double seconds =
+        chrono::duration<double>(Clock::now() - start).count();
+
+    cerr << batch.images.size() << " images, " << batch.failed
+         << " unreadable, " << batch.glyphs << " glyphs in " << seconds
+         << " s on " << jobs << " threads, "
+         << batch.images.size() / seconds << " images/s" << endl;
+  } catch (const char* error) {
+    cerr << error << endl;
+    return 1;
+  }
+
+  return 0;
+}
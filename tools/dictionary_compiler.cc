@@ -0,0 +1,49 @@
+// Compiles a text glyph dictionary into the binary format GlyphValidator
+// maps at startup, see glyph_dictionary.h.
+//
+//    ./dictionary_compiler.bin glyph_schema.txt glyph_schema.bin
+//
+// The output is only valid on machines with the same byte order.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "glyph_dictionary.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+  if (argc != 3) {
+    cerr << "usage: " << argv[0] << " <dictionary.txt> <dictionary.bin>"
+         << endl;
+    return 1;
+  }
+
+  vector<char> data;
+  try {
+    data = GlyphDictionary::Compile(argv[1]);
+  } catch (const char* error) {
+    cerr << error << endl;
+    return 1;
+  }
+
+  // Written next to the target and renamed, so that running detectors that
+  // have the old file mapped keep seeing a complete dictionary.
+  const string temporary = string(argv[2]) + ".tmp";
+  ofstream ofile(temporary.c_str(), ios::binary);
+  ofile.write(data.data(), data.size());
+  ofile.close();
+  if (!ofile || rename(temporary.c_str(), argv[2]) != 0) {
+    cerr << "Couldn't write " << argv[2] << endl;
+    return 1;
+  }
+
+  const DictionaryHeader* header =
+      reinterpret_cast<const DictionaryHeader*>(data.data());
+  cout << header->glyphCount << " glyphs, " << header->entryCount
+       << " codes, " << data.size() << " bytes" << endl;
+  return 0;
+}
@@ -0,0 +1,131 @@
+// Overflows the track event queue with moving glyphs while one glyph lies
+// still on the table, then resynchronizes the way GlyphDetector and the
+// game do: the queue is drained, the tracker snapshot replaces the events
+// and a fresh PoseTracker is fed from it.
+//
+//    ./event_resync_benchmark.bin [moving glyphs] [seconds]
+//
+// Defaults to 64 moving glyphs for 2 seconds of 30 fps frames, through a
+// queue of 256 events. Prints how long the snapshot took and fails unless
+// every live track, the still one included, is predicted again right after
+// the resync and the snapshot carries the time of the latest frame.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "configuration.h"
+#include "glyph.h"
+#include "glyph_tracker.h"
+#include "pose_tracker.h"
+#include "spsc_queue.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static const size_t QUEUE_CAPACITY = 256;
+static const double FRAME_S = 1.0 / 30;
+static const float GLYPH_SIZE = 40;
+
+static Glyph GlyphAt(const int id, const float x, const float y)
+{
+  Glyph glyph(3, id);
+  glyph.SetId(id);
+  vector<Point2f> corners;
+  corners.push_back(Point2f(x, y));
+  corners.push_back(Point2f(x + GLYPH_SIZE, y));
+  corners.push_back(Point2f(x + GLYPH_SIZE, y + GLYPH_SIZE));
+  corners.push_back(Point2f(x, y + GLYPH_SIZE));
+  glyph.SetPose(corners);
+
+  return glyph;
+}
+
+int main(int argc, char** argv)
+{
+  const int moving = argc > 1 ? atoi(argv[1]) : 64;
+  const double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+  if (moving <= 0 || seconds <= 0) {
+    cerr << "usage: " << argv[0] << " [moving glyphs] [seconds]" << endl;
+    return 1;
+  }
+
+  Configuration::Instance().LoadOnce("configuration.txt");
+
+  GlyphTracker tracker;
+  SpscQueue<GlyphEvent> queue(QUEUE_CAPACITY);
+  bool overflowed = false;
+  long overflows = 0;
+
+  // Glyph 0 never moves; the others each cross the table at their own row.
+  const Clock::time_point start = Clock::now();
+  Clock::time_point captured = start;
+  const int frames = int(seconds / FRAME_S);
+  vector<GlyphEvent> events;
+  for (int frame = 0; frame < frames; ++frame) {
+    captured = start + chrono::duration_cast<Clock::duration>(
+        chrono::duration<double>(frame * FRAME_S));
+
+    vector<Glyph> glyphs;
+    glyphs.push_back(GlyphAt(0, 20, 20));
+    for (int i = 1; i <= moving; ++i) {
+      glyphs.push_back(GlyphAt(i, 20 + frame * 5.0f, 100 + i * 60.0f));
+    }
+
+    // Nobody pops, like a consumer that stalled.
+    events.clear();
+    tracker.Update(glyphs, captured, &events);
+    for (auto& event : events) {
+      if (overflowed || !queue.TryPush(event)) {
+        overflows += !overflowed;
+        overflowed = true;
+        break;
+      }
+    }
+  }
+
+  if (!overflowed) {
+    cerr << "The queue never overflowed" << endl;
+    return 1;
+  }
+
+  GlyphEvent event;
+  while (queue.TryPop(&event)) {
+  }
+  const Clock::time_point before = Clock::now();
+  tracker.Snapshot(captured, &events);
+  const double snapshotUs =
+      chrono::duration<double, micro>(Clock::now() - before).count();
+
+  PoseTracker poses;
+  bool stamped = true;
+  for (auto& event : events) {
+    Pose pose;
+    pose.center = Point2d(event.x, event.y);
+    pose.angle = event.angle;
+    poses.Measure(event.track, pose, event.captured, false);
+    stamped &= event.captured == captured;
+  }
+
+  // The game predicts at render time, shortly after the frame.
+  map<int, Pose> predicted;
+  poses.PredictActive(captured + chrono::milliseconds(50), &predicted);
+
+  cout << "tracks " << events.size() << ", predicted " << predicted.size()
+       << ", overflows " << overflows << ", snapshot " << snapshotUs << " us"
+       << endl;
+
+  if (events.size() != size_t(moving + 1) ||
+      predicted.size() != events.size() || !stamped) {
+    cerr << "Tracks went missing over the resync" << endl;
+    return 1;
+  }
+
+  return 0;
+}
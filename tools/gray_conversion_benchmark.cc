@@ -0,0 +1,241 @@
+// Checks the fused gray conversion of GrayConverter against OpenCV and
+// measures its throughput. Random BGR and YUYV frames are shrunk by 1/2
+// and 1/4 by
+//
+//    two_step       resize with the default interpolation, then cvtColor,
+//                   what the worker did before the fused pass
+//    area_two_step  resize with INTER_AREA and cvtColor, the reference
+//    fused_generic  the fused pass in plain C++
+//    fused_simd     the fused pass with SSE2, where the build has it
+//
+//    ./gray_conversion_benchmark.bin [width] [height]
+//
+// The frame size defaults to 1280x720. Like camera modes it should divide
+// by 4, otherwise INTER_AREA weighs partial blocks at the edges. Prints one
+// CSV line per path, and fails if a fused pass is off by more than
+// TOLERANCE gray levels from the reference or the two fused passes differ
+// at all.
+//
+// Then FrameProcessor::Prepare converts only a region, starting on an odd
+// column, of smooth BGR and YUYV frames at several factors. One more CSV
+// line per format and factor, path "region", gives how far the region is
+// off the whole frame converted; it fails past TOLERANCE, or if anything
+// outside the region isn't black. Needs configuration.txt and
+// glyph_schema.txt in the working directory.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "opencv2/opencv.hpp"
+
+#include "configuration.h"
+#include "frame_processor.h"
+#include "gray_converter.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// The fused pass rounds once, the reference after the resize and again
+// after the conversion.
+static const double TOLERANCE = 1;
+static const int REPETITIONS = 200;
+static const char* DICTIONARY = "glyph_schema.txt";
+
+static Mat RandomFrame(const int width, const int height, const int type)
+{
+  Mat frame(height, width, type);
+  for (int y = 0; y < height; ++y) {
+    uchar* row = frame.ptr<uchar>(y);
+    for (int x = 0; x < width * frame.channels(); ++x) {
+      row[x] = rand() % 256;
+    }
+  }
+
+  return frame;
+}
+
+// Interpolating crops rather than the whole frame shifts samples by a
+// fraction of a pixel, which a gradient hardly notices and noise would.
+static Mat GradientFrame(const int width, const int height, const int type)
+{
+  Mat frame(height, width, type);
+  for (int y = 0; y < height; ++y) {
+    uchar* row = frame.ptr<uchar>(y);
+    for (int x = 0; x < width; ++x) {
+      const uchar value = (x + y) * 255 / (width + height);
+      for (int c = 0; c < frame.channels(); ++c) {
+        // Chroma of YUYV is left neutral.
+        row[x * frame.channels() + c] = type == CV_8UC2 && c == 1 ? 128
+                                                                  : value;
+      }
+    }
+  }
+
+  return frame;
+}
+
+static void Reference(const Mat& frame, const float factor, Mat* gray)
+{
+  const Size size(frame.cols * factor, frame.rows * factor);
+  if (frame.type() == CV_8UC2) {
+    cvtColor(frame, *gray, CV_YUV2GRAY_YUYV);
+    resize(*gray, *gray, size, 0, 0, INTER_AREA);
+  } else {
+    Mat resized;
+    resize(frame, resized, size, 0, 0, INTER_AREA);
+    cvtColor(resized, *gray, CV_BGR2GRAY);
+  }
+}
+
+static void TwoStep(const Mat& frame, const float factor, Mat* gray)
+{
+  const Size size(frame.cols * factor, frame.rows * factor);
+  if (frame.type() == CV_8UC2) {
+    cvtColor(frame, *gray, CV_YUV2GRAY_YUYV);
+    resize(*gray, *gray, size);
+  } else {
+    Mat resized;
+    resize(frame, resized, size);
+    cvtColor(resized, *gray, CV_BGR2GRAY);
+  }
+}
+
+static double MaxDifference(const Mat& a, const Mat& b)
+{
+  if (a.size() != b.size()) {
+    return 255;
+  }
+  Mat difference;
+  absdiff(a, b, difference);
+  double max = 0;
+  minMaxLoc(difference, nullptr, &max);
+  return max;
+}
+
+// Prepares a region of a gradient frame and compares it with the whole
+// frame converted. Returns false if it is off or leaks outside the region.
+static bool CheckRegion(FrameProcessor* processor, const string& format,
+                        const Mat& frame, const float factor)
+{
+  // Starts on an odd column, halfway through a YUYV pair.
+  const Rect region(frame.cols / 4 + 1, frame.rows / 4, frame.cols / 3,
+                    frame.rows / 3);
+  FrameProcessor::Regions regions(1);
+  regions[0].push_back(Point2f(region.tl()));
+  regions[0].push_back(Point2f(region.br().x, region.y));
+  regions[0].push_back(Point2f(region.br()));
+  regions[0].push_back(Point2f(region.x, region.br().y));
+
+  Mat gray;
+  processor->Prepare(frame, factor, regions, &gray);
+  Mat whole;
+  GrayConverter().Convert(frame, factor, &whole);
+
+  // Pixels at the edges of the region interpolate across it.
+  const Rect inside(cvCeil(region.x * factor) + 1,
+                    cvCeil(region.y * factor) + 1,
+                    cvFloor(region.width * factor) - 2,
+                    cvFloor(region.height * factor) - 2);
+  const double difference = MaxDifference(gray(inside), whole(inside));
+  Mat outside = gray.clone();
+  outside(Rect(cvFloor(region.x * factor), cvFloor(region.y * factor),
+               cvCeil(region.width * factor) + 2,
+               cvCeil(region.height * factor) + 2)).setTo(Scalar(0));
+
+  cout << format << "," << factor << ",region,,," << difference << endl;
+  return difference <= TOLERANCE && countNonZero(outside) == 0;
+}
+
+int main(int argc, char** argv)
+{
+  const int width = argc > 1 ? atoi(argv[1]) : 1280;
+  const int height = argc > 2 ? atoi(argv[2]) : 720;
+  if (width <= 0 || height <= 0) {
+    cerr << "usage: " << argv[0] << " [width] [height]" << endl;
+    return 1;
+  }
+
+  const float factors[] = { 0.5f, 0.25f };
+  const int types[] = { CV_8UC3, CV_8UC2 };
+  GrayConverter generic(false);
+  GrayConverter simd(true);
+  bool passed = true;
+
+  cout << "format,factor,path,ms_per_frame,source_mb_per_s,max_difference"
+       << endl;
+  for (int type : types) {
+    const Mat frame = RandomFrame(width, height, type);
+    const double megabytes = frame.total() * frame.elemSize() / 1e6;
+    const string format = type == CV_8UC2 ? "yuyv" : "bgr";
+
+    for (float factor : factors) {
+      Mat reference;
+      Reference(frame, factor, &reference);
+
+      Mat fusedGeneric;
+      generic.ConvertFused(frame, factor, &fusedGeneric);
+
+      for (int path = 0; path < 4; ++path) {
+        if (path == 3 && !GrayConverter::HasSimd()) {
+          continue;
+        }
+
+        Mat gray;
+        const Clock::time_point start = Clock::now();
+        for (int i = 0; i < REPETITIONS; ++i) {
+          switch (path) {
+            case 0: TwoStep(frame, factor, &gray); break;
+            case 1: Reference(frame, factor, &gray); break;
+            case 2: generic.ConvertFused(frame, factor, &gray); break;
+            case 3: simd.ConvertFused(frame, factor, &gray); break;
+          }
+        }
+        const double seconds =
+            chrono::duration<double>(Clock::now() - start).count();
+
+        const double difference = MaxDifference(gray, reference);
+        if (path >= 2 && difference > TOLERANCE) {
+          passed = false;
+        }
+        if (path == 3 && MaxDifference(gray, fusedGeneric) != 0) {
+          cerr << "SSE2 and generic passes differ" << endl;
+          passed = false;
+        }
+
+        const char* names[] = { "two_step", "area_two_step", "fused_generic",
+                                "fused_simd" };
+        cout << format << "," << factor << "," << names[path] << ","
+             << seconds * 1000 / REPETITIONS << ","
+             << megabytes * REPETITIONS / seconds << "," << difference
+             << endl;
+      }
+    }
+  }
+
+  if (!passed) {
+    cerr << "Fused conversion out of tolerance" << endl;
+    return 1;
+  }
+
+  Configuration::Instance().LoadOnce("configuration.txt");
+  FrameProcessor processor(DICTIONARY);
+  const float regionFactors[] = { 1.0f, 0.75f, 0.5f, 0.25f };
+  for (int type : types) {
+    const Mat frame = GradientFrame(width, height, type);
+    const string format = type == CV_8UC2 ? "yuyv" : "bgr";
+    for (float factor : regionFactors) {
+      passed &= CheckRegion(&processor, format, frame, factor);
+    }
+  }
+
+  if (!passed) {
+    cerr << "Region conversion out of tolerance" << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Replays an MJPEG file through both input paths of the detector: a full
+// color decode followed by resize and cvtColor, and the scaled grayscale
+// decode of JpegDecoder. Times the decode and counts the glyphs each path
+// finds, so the fast path can be checked offline against camera captures.
+//
+//    ./mjpeg_benchmark.bin capture.mjpeg [resize_factor]
+//
+// A capture can be recorded with
+//
+//    ffmpeg -f v4l2 -input_format mjpeg -i /dev/video0 -c copy -f mjpeg capture.mjpeg
+//
+// The factor defaults to frame_resize_factor. Prints one CSV line per path.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "blob_detector.h"
+#include "configuration.h"
+#include "glyph_validator.h"
+#include "jpeg_decoder.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    cerr << "usage: " << argv[0] << " <capture.mjpeg> [resize_factor]" << endl;
+    return 1;
+  }
+
+  Configuration::Instance().LoadOnce("configuration.txt");
+  const float factor = argc > 2
+      ? atof(argv[2])
+      : Configuration::Instance().ReadFloat("frame_resize_factor");
+
+  vector<Mat> frames;
+  try {
+    MjpegReader reader(argv[1]);
+    for (Mat frame; reader.Next(&frame); frame = Mat()) {
+      frames.push_back(frame);
+    }
+  } catch (const char* error) {
+    cerr << error << endl;
+    return 1;
+  }
+  if (frames.empty()) {
+    cerr << "No frames in " << argv[1] << endl;
+    return 1;
+  }
+
+  const int denominator = JpegDecoder::ScaleDenominator(factor);
+  const float rest = factor * denominator;
+
+  cout << "path,frames,failed,ms_per_decode,size,glyphs" << endl;
+  for (int path = 0; path < 2; ++path) {
+    JpegDecoder decoder;
+    BlobDetector detector;
+    GlyphValidator validator("glyph_schema.txt");
+    double decodeMs = 0;
+    int failed = 0;
+    long glyphs = 0;
+    Size size;
+
+    for (const Mat& frame : frames) {
+      const Clock::time_point start = Clock::now();
+      Mat gray;
+      if (path == 0) {
+        Mat color = imdecode(frame, CV_LOAD_IMAGE_COLOR);
+        if (!color.empty()) {
+          resize(color, color, Size(color.cols * factor, color.rows * factor));
+          cvtColor(color, gray, CV_BGR2GRAY);
+        }
+      } else if (!decoder.Decode(frame.ptr<uint8_t>(), frame.total(),
+                                 denominator, &gray)) {
+        gray = Mat();
+      } else if (rest != 1.0f) {
+        resize(gray, gray, Size(gray.cols * rest, gray.rows * rest));
+      }
+      decodeMs += chrono::duration<double, milli>(Clock::now() - start).count();
+
+      if (gray.empty()) {
+        ++failed;
+        continue;
+      }
+      size = gray.size();
+
+      detector.Run(gray);
+      for (int i = 0; i < detector.GetCandidatesCount(); ++i) {
+        Glyph glyph("");
+        glyphs += validator.Validate(gray, detector.GetVertices(i), nullptr,
+                                     &glyph);
+      }
+    }
+
+    cout << (path == 0 ? "decode_resize_cvtcolor" : "scaled_gray_decode")
+         << "," << frames.size() << "," << failed << ","
+         << decodeMs / frames.size() << "," << size.width << "x"
+         << size.height << "," << glyphs << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+// Headless stress test of the ball/brick collision step. The play area grows
+// with the number of bricks so that their density stays the same, and a
+// tenth of the bricks is moved every tick, like glyphs moving on the table.
+//
+//    ./physics_benchmark.bin [ticks]
+//
+// Prints one CSV line per brick count, with the rate of whole ticks and of
+// the collision step alone. Moving bricks costs O(moved bricks) on its own.
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "physics.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static const float BRICK_WIDTH = 32.0f;
+static const float BRICK_HEIGHT = 16.0f;
+// Play area per brick, in square pixels.
+static const float AREA_PER_BRICK = 64.0f * 64.0f;
+static const float STEP = 1.0f / 60.0f;
+
+static float Random(const float range)
+{
+  return range * rand() / static_cast<float>(RAND_MAX);
+}
+
+static Aabb BrickAt(const float x, const float y)
+{
+  Aabb bounds;
+  bounds.x0 = x;
+  bounds.y0 = y;
+  bounds.x1 = x + BRICK_WIDTH;
+  bounds.y1 = y + BRICK_HEIGHT;
+
+  return bounds;
+}
+
+int main(int argc, char** argv)
+{
+  const int ticks = argc > 1 ? atoi(argv[1]) : 20000;
+  const int counts[] = { 10, 100, 1000, 5000, 10000, 50000 };
+
+  cout << "bricks,ticks_per_sec,step_ticks_per_sec,"
+       << "narrow_phase_tests_per_tick" << endl;
+  for (int count : counts) {
+    srand(1);
+    const float side = sqrt(count * AREA_PER_BRICK);
+    Physics physics(side, side, 64.0f);
+
+    vector<Aabb> bricks;
+    for (int i = 0; i < count; ++i) {
+      bricks.push_back(BrickAt(Random(side - BRICK_WIDTH),
+                               Random(side - BRICK_HEIGHT)));
+      physics.AddBrick(bricks.back());
+    }
+
+    Ball ball;
+    ball.x = side / 2;
+    ball.y = side / 2;
+    ball.vx = 400;
+    ball.vy = 300;
+    ball.radius = 8;
+    physics.SetBall(ball);
+
+    const int moved = max(1, count / 10);
+    long tests = 0;
+    Clock::duration stepTime(0);
+    const Clock::time_point start = Clock::now();
+    for (int t = 0; t < ticks; ++t) {
+      for (int i = 0; i < moved; ++i) {
+        const int id = (t * moved + i) % count;
+        Aabb& bounds = bricks[id];
+        const float dx = Random(4.0f) - 2.0f;
+        const float dy = Random(4.0f) - 2.0f;
+        bounds = BrickAt(min(max(bounds.x0 + dx, 0.0f), side - BRICK_WIDTH),
+                         min(max(bounds.y0 + dy, 0.0f), side - BRICK_HEIGHT));
+        physics.MoveBrick(id, bounds);
+      }
+
+      const Clock::time_point stepStart = Clock::now();
+      physics.Step(STEP);
+      stepTime += Clock::now() - stepStart;
+      tests += physics.NarrowPhaseTests();
+    }
+    const double seconds =
+        chrono::duration<double>(Clock::now() - start).count();
+    const double stepSeconds = chrono::duration<double>(stepTime).count();
+
+    cout << count << "," << ticks / seconds << "," << ticks / stepSeconds
+         << "," << tests / static_cast<double>(ticks) << endl;
+  }
+
+  return 0;
+}
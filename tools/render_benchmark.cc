@@ -0,0 +1,102 @@
+// Compares drawing bricks with one SDL_RenderCopyEx call per sprite against
+// the batched atlas path used by Game. It renders headless into a software
+// renderer, so it runs under SDL's dummy video driver:
+//
+//    SDL_VIDEODRIVER=dummy ./render_benchmark.bin [frames]
+//
+// Prints one CSV line per brick count.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "SDL.h"
+#include "SDL_image.h"
+
+#include "sprite_batch.h"
+#include "texture_atlas.h"
+
+using namespace std;
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+
+typedef chrono::steady_clock Clock;
+
+static double FramesPerSecond(const Clock::time_point start, const int frames)
+{
+  return frames / chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+  const int frames = argc > 1 ? atoi(argv[1]) : 200;
+
+  setenv("SDL_VIDEODRIVER", "dummy", 0);
+  if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+    cout << "SDL_Init error: " << SDL_GetError() << endl;
+    return 1;
+  }
+  IMG_Init(IMG_INIT_PNG);
+
+  SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(
+      0, WIDTH, HEIGHT, 32, SDL_PIXELFORMAT_RGBA32);
+  SDL_Renderer* renderer = SDL_CreateSoftwareRenderer(target);
+
+  TextureAtlas atlas;
+  if (renderer == nullptr || !atlas.Load("resources", renderer) ||
+      atlas.Find("brick") == nullptr) {
+    cout << "Unable to set up the renderer: " << SDL_GetError() << endl;
+    return 1;
+  }
+  const AtlasSprite& sprite = *atlas.Find("brick");
+  SDL_Texture* texture = IMG_LoadTexture(renderer, "resources/brick.png");
+
+  SpriteBatch batch;
+  const int counts[] = { 10, 100, 1000, 5000 };
+
+  cout << "bricks,individual_fps,batched_fps" << endl;
+  for (int count : counts) {
+    srand(1);
+    vector<SDL_Point> positions(count);
+    for (auto& p : positions) {
+      p.x = rand() % WIDTH;
+      p.y = rand() % HEIGHT;
+    }
+
+    Clock::time_point start = Clock::now();
+    for (int f = 0; f < frames; ++f) {
+      SDL_RenderClear(renderer);
+      for (auto& p : positions) {
+        int w, h;
+        SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+        SDL_Rect dst = { p.x, p.y, w, h };
+        SDL_RenderCopyEx(renderer, texture, NULL, &dst, f, NULL,
+                         SDL_FLIP_NONE);
+      }
+      SDL_RenderPresent(renderer);
+    }
+    const double individual = FramesPerSecond(start, frames);
+
+    start = Clock::now();
+    for (int f = 0; f < frames; ++f) {
+      SDL_RenderClear(renderer);
+      for (auto& p : positions) {
+        batch.Add(sprite, p.x, p.y, f);
+      }
+      batch.Flush(renderer, atlas.Texture());
+      SDL_RenderPresent(renderer);
+    }
+    const double batched = FramesPerSecond(start, frames);
+
+    cout << count << "," << individual << "," << batched << endl;
+  }
+
+  SDL_DestroyTexture(texture);
+  atlas.Clear();
+  SDL_DestroyRenderer(renderer);
+  SDL_FreeSurface(target);
+  SDL_Quit();
+  return 0;
+}
@@ -0,0 +1,181 @@
+// Feeds a session log recorded by the detector (recorder_enabled) back
+// through the FrameProcessor with the recorded configuration, and diffs
+// the candidates, glyphs and timings against the recording.
+//
+//    ./replay.bin session.log [dictionary]
+//
+// Prints one line per frame whose results differ, then a summary. Keys the
+// recording doesn't have are taken from configuration.txt.
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "configuration.h"
+#include "frame_processor.h"
+#include "glyph_detector.h"
+#include "session_log.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// Largest difference in pixels, or degrees, still counted as the same.
+static const float TOLERANCE = 0.5f;
+
+struct Timing
+{
+  Timing() : count(0), sum(0), max(0) {}
+
+  void Add(const double ms)
+  {
+    ++count;
+    sum += ms;
+    max = std::max(max, ms);
+  }
+
+  long count;
+  double sum;
+  double max;
+};
+
+static bool SameGlyphs(vector<LoggedGlyph> lhs, vector<LoggedGlyph> rhs)
+{
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+
+  auto byId = [](const LoggedGlyph& a, const LoggedGlyph& b) {
+    return a.id < b.id || (a.id == b.id && a.x < b.x);
+  };
+  sort(lhs.begin(), lhs.end(), byId);
+  sort(rhs.begin(), rhs.end(), byId);
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    if (lhs[i].id != rhs[i].id || fabs(lhs[i].x - rhs[i].x) > TOLERANCE ||
+        fabs(lhs[i].y - rhs[i].y) > TOLERANCE ||
+        fabs(remainder(lhs[i].angle - rhs[i].angle, 360.0f)) > TOLERANCE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool SameCandidates(const vector<Point2f>& lhs,
+                           const vector<Point2f>& rhs)
+{
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    if (fabs(lhs[i].x - rhs[i].x) > TOLERANCE ||
+        fabs(lhs[i].y - rhs[i].y) > TOLERANCE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void Print(const string& name, const Timing& timing)
+{
+  cout << name << ": " << timing.sum / max(timing.count, 1L) << " ms mean, "
+       << timing.max << " ms max" << endl;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    cerr << "usage: " << argv[0] << " <session.log> [dictionary]" << endl;
+    return 1;
+  }
+
+  try {
+    SessionLogReader log(argv[1]);
+
+    Configuration& config = Configuration::Instance();
+    config.LoadOnce("configuration.txt");
+    stringstream snapshot(log.Config());
+    string name, value;
+    while (snapshot >> name >> value) {
+      config.Set(name, value);
+    }
+
+    FrameProcessor processor(argc > 2 ? argv[2] : "glyph_schema.txt");
+
+    long frames = 0;
+    long candidateMismatches = 0;
+    long glyphMismatches = 0;
+    Timing recorded, replayed, latency;
+    int64_t firstNs = 0, lastNs = 0;
+
+    SessionFrame frame;
+    while (log.Next(&frame)) {
+      const Clock::time_point start = Clock::now();
+
+      int maxCandidates = INT_MAX;
+      if (frame.degradationLevel >= CapCandidates) {
+        maxCandidates = config.ReadInt("degraded_max_candidates");
+      }
+
+      // The recorded frame is already the working frame, with only the
+      // regions converted if there were any.
+      vector<Point2f> candidates;
+      vector<Glyph> found;
+      processor.Detect(frame.gray, frame.resizeFactor, frame.regions,
+                       maxCandidates, nullptr, &candidates, &found);
+
+      replayed.Add(
+          chrono::duration<double, milli>(Clock::now() - start).count());
+      recorded.Add(frame.processingMs);
+      latency.Add(frame.latencyMs);
+
+      vector<LoggedGlyph> glyphs;
+      for (auto& glyph : found) {
+        LoggedGlyph logged = { glyph.Id(), float(glyph.Center().x),
+                               float(glyph.Center().y),
+                               float(glyph.Angle()) };
+        glyphs.push_back(logged);
+      }
+
+      const bool sameCandidates = SameCandidates(frame.candidates, candidates);
+      const bool sameGlyphs = SameGlyphs(frame.glyphs, glyphs);
+      if (!sameCandidates || !sameGlyphs) {
+        cout << "frame " << frame.sequence << ": candidates "
+             << frame.candidates.size() / 4 << " -> " << candidates.size() / 4
+             << ", glyphs " << frame.glyphs.size() << " -> " << glyphs.size()
+             << (sameGlyphs ? "" : " (glyphs differ)") << endl;
+      }
+      candidateMismatches += !sameCandidates;
+      glyphMismatches += !sameGlyphs;
+
+      if (frames == 0) {
+        firstNs = frame.capturedNs;
+      }
+      lastNs = frame.capturedNs;
+      ++frames;
+    }
+
+    cout << frames << " frames, " << candidateMismatches
+         << " with different candidates, " << glyphMismatches
+         << " with different glyphs" << endl;
+    if (frames > 1) {
+      cout << "recorded at " << (frames - 1) * 1e9 / (lastNs - firstNs)
+           << " fps" << endl;
+    }
+    Print("recorded processing", recorded);
+    Print("replayed processing", replayed);
+    Print("recorded capture to result", latency);
+
+    return candidateMismatches + glyphMismatches > 0 ? 2 : 0;
+  } catch (const char* error) {
+    cerr << error << endl;
+    return 1;
+  }
+}
@@ -0,0 +1,429 @@
+// Microbenchmarks of the individual stages of BlobDetector and
+// GlyphValidator on fixed synthetic inputs, over a range of frame sizes,
+// glyph counts, blob sizes and vertex counts.
+//
+//    ./stage_benchmark.bin [filter]
+//
+// Only benchmarks whose name contains filter are run. Every result is
+// printed as one JSON object per line, so runs of different commits can be
+// compared with a script. The CornerModes check counts the candidates of
+// the labeled frames that shared corner mode loses against per_blob mode,
+// and the AdjacentBlobs check squares next to and inside each other that
+// don't get four corners of their own in both modes; the tool fails if
+// there are any, or if a shared mode corner lies outside its blob.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "blob_detector.h"
+#include "configuration.h"
+#include "glyph_validator.h"
+#include "synthetic_scene.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// Each benchmark repeats its operation until it ran for at least this long.
+static const double MIN_SECONDS = 0.2;
+
+class StageBenchmark
+{
+ public:
+  StageBenchmark(const string& filter)
+      : filter_(filter)
+      , validator_("glyph_schema.txt")
+      , mismatches_(0)
+  {
+  }
+
+  // Blobs the corner checks failed on.
+  long Mismatches() const { return mismatches_; }
+
+  void Run()
+  {
+    const Size frameSizes[] = { Size(320, 240), Size(640, 480),
+                                Size(1280, 960) };
+    const int glyphCounts[] = { 1, 8, 32 };
+    const int blobSizes[] = { 35, 70, 140, 280 };
+    const int vertexCounts[] = { 8, 32, 128, 512 };
+
+    for (const Size& size : frameSizes) {
+      Frame(size);
+      for (int glyphs : glyphCounts) {
+        Labeling(size, glyphs);
+      }
+    }
+
+    for (int size : blobSizes) {
+      Blob(size);
+      Cells(size);
+      AdjacentBlobs(size, false);
+      AdjacentBlobs(size, true);
+    }
+
+    for (int count : vertexCounts) {
+      Reduce(count);
+    }
+  }
+
+ private:
+  template <typename F>
+  void Measure(const string& name, const string& params, F operation)
+  {
+    if (name.find(filter_) == string::npos) {
+      return;
+    }
+
+    // Double the iterations until the run is long enough to be timed.
+    long iterations = 1;
+    double seconds = 0;
+    while (true) {
+      const Clock::time_point start = Clock::now();
+      for (long i = 0; i < iterations; ++i) {
+        operation();
+      }
+      seconds = chrono::duration<double>(Clock::now() - start).count();
+
+      if (seconds >= MIN_SECONDS) {
+        break;
+      }
+      iterations *= 2;
+    }
+
+    cout << "{\"benchmark\":\"" << name << "\",\"params\":{" << params
+         << "},\"iterations\":" << iterations
+         << ",\"ns_per_op\":" << seconds * 1e9 / iterations << "}" << endl;
+  }
+
+  static string FrameParams(const Size& size)
+  {
+    stringstream ss;
+    ss << "\"frame\":\"" << size.width << "x" << size.height << "\"";
+    return ss.str();
+  }
+
+  static BlobDetector::CornerHarrisParams HarrisParams()
+  {
+    BlobDetector::CornerHarrisParams harris;
+    harris.blockSize =
+        Configuration::Instance().ReadInt("corner_harris_block_size");
+    harris.apertureSize =
+        Configuration::Instance().ReadInt("corner_harris_aperture_size");
+    harris.freeCoefficient =
+        Configuration::Instance().ReadDouble("corner_harris_free_coefficient");
+    harris.threshold =
+        Configuration::Instance().ReadDouble("corner_harris_threshold");
+    harris.responseThreshold =
+        Configuration::Instance().ReadFloat("corner_response_threshold");
+    return harris;
+  }
+
+  static string Param(const string& name, const int value)
+  {
+    stringstream ss;
+    ss << "\"" << name << "\":" << value;
+    return ss.str();
+  }
+
+  // Whole-frame segmentation.
+  void Frame(const Size& size)
+  {
+    const Mat scene = SyntheticScene(size.width, size.height, 8);
+    const string params = FrameParams(size);
+
+    Measure("DetectGradient", params, [&]() {
+      detector_.DetectGradient(scene);
+    });
+    Measure("DetectBrightRegions", params, [&]() {
+      detector_.DetectBrightRegions(scene);
+    });
+  }
+
+  // The labeling loop: target setup and a flood fill per component.
+  void Labeling(const Size& size, const int glyphs)
+  {
+    const Mat scene = SyntheticScene(size.width, size.height, glyphs);
+    const Mat mask = detector_.DetectGradient(scene);
+    const int minBlobSize = 0.05f * size.width;
+    const int maxBlobSize = 0.4f * size.width;
+
+    const string params = FrameParams(size) + "," + Param("glyphs", glyphs);
+
+    Measure("Label", params, [&]() {
+      detector_.blobs_.Clear();
+      detector_.Label(mask, minBlobSize, maxBlobSize);
+    });
+
+    // Corners of every blob of the frame, one response per blob against a
+    // single shared one.
+    detector_.blobs_.Clear();
+    detector_.Label(mask, minBlobSize, maxBlobSize);
+    vector<Bitmap> filled(detector_.blobs_.Size());
+    for (size_t i = 0; i < filled.size(); ++i) {
+      detector_.FillHoles(i, &filled[i]);
+    }
+    const BlobDetector::CornerHarrisParams harris = HarrisParams();
+
+    Measure("CornersPerBlob", params, [&]() {
+      for (size_t i = 0; i < filled.size(); ++i) {
+        vector<Point2f> vertices;
+        detector_.DetectVertices(filled[i], harris, detector_.blobs_.bbox[i],
+                                 &vertices);
+      }
+    });
+    Measure("CornersShared", params, [&]() {
+      detector_.blobs_.vertices.clear();
+      detector_.DetectSharedVertices(filled, harris);
+    });
+
+    // Shared mode must keep every candidate, every blob with four corners,
+    // that per_blob mode finds. It may find a few more on irregular blobs,
+    // where the normalization of per_blob mode raises the threshold;
+    // validation rejects those.
+    if (string("CornerModes").find(filter_) == string::npos) {
+      return;
+    }
+    detector_.blobs_.vertices.clear();
+    detector_.DetectSharedVertices(filled, harris);
+    int lost = 0;
+    int extra = 0;
+    for (size_t i = 0; i < filled.size(); ++i) {
+      const bool perBlob = PerBlobCorners(filled[i], i, harris) == 4;
+      const bool shared = detector_.blobs_.vertexCount[i] == 4;
+      lost += perBlob && !shared;
+      extra += shared && !perBlob;
+    }
+    const int outside = CornersOutside();
+    mismatches_ += lost + outside;
+    cout << "{\"check\":\"CornerModes\",\"params\":{" << params
+         << "},\"blobs\":" << filled.size() << ",\"lost_candidates\":"
+         << lost << ",\"extra_candidates\":" << extra
+         << ",\"corners_outside\":" << outside << "}" << endl;
+  }
+
+  // Corners per_blob mode finds on blob i after merging them.
+  int PerBlobCorners(const Bitmap& filled, const int blob,
+                     const BlobDetector::CornerHarrisParams& harris)
+  {
+    vector<Point2f> vertices;
+    detector_.DetectVertices(filled, harris, detector_.blobs_.bbox[blob],
+                             &vertices);
+    if (vertices.size() > 1) {
+      detector_.ReduceVertices(
+          vertices, &vertices,
+          Configuration::Instance().ReadFloat("vertices_merging_distance"));
+    }
+    return vertices.size();
+  }
+
+  // Blobs with a shared mode corner outside their bbox and its padding.
+  int CornersOutside() const
+  {
+    const BlobTable& blobs = detector_.blobs_;
+    int outside = 0;
+    for (size_t i = 0; i < blobs.Size(); ++i) {
+      const Rect padded(blobs.bbox[i].x - 1, blobs.bbox[i].y - 1,
+                        blobs.bbox[i].width + 2, blobs.bbox[i].height + 2);
+      bool inside = true;
+      for (int j = 0; j < blobs.vertexCount[i]; ++j) {
+        const Point2f& vertex = blobs.vertices[blobs.vertexBegin[i] + j];
+        inside &= padded.contains(Point(cvRound(vertex.x),
+                                        cvRound(vertex.y)));
+      }
+      outside += !inside;
+    }
+    return outside;
+  }
+
+  // Squares of size x size pixels, two side by side split by a one pixel
+  // gap, or one in the middle of a square ring. Each has to get its own
+  // four corners in both modes, none taken from the other.
+  void AdjacentBlobs(const int size, const bool nested)
+  {
+    const string name = "AdjacentBlobs";
+    if (name.find(filter_) == string::npos) {
+      return;
+    }
+
+    Mat scene(4 * size, 4 * size, CV_8UC1, Scalar(230));
+    if (nested) {
+      rectangle(scene, Rect(size / 2, size / 2, 3 * size, 3 * size),
+                Scalar(20), -1);
+      rectangle(scene, Rect(size, size, 2 * size, 2 * size), Scalar(230), -1);
+      rectangle(scene, Rect(3 * size / 2, 3 * size / 2, size, size),
+                Scalar(20), -1);
+    } else {
+      rectangle(scene, Rect(size, size, size, size), Scalar(20), -1);
+      rectangle(scene, Rect(2 * size + 1, size, size, size), Scalar(20), -1);
+    }
+
+    // The dark pixels are the blobs; the background is too large to keep.
+    detector_.blobs_.Clear();
+    detector_.Label(scene > 128, 0, scene.cols);
+    vector<Bitmap> filled(detector_.blobs_.Size());
+    for (size_t i = 0; i < filled.size(); ++i) {
+      detector_.FillHoles(i, &filled[i]);
+    }
+    const BlobDetector::CornerHarrisParams harris = HarrisParams();
+    detector_.blobs_.vertices.clear();
+    detector_.DetectSharedVertices(filled, harris);
+
+    int wrong = filled.size() != 2;
+    for (size_t i = 0; i < filled.size(); ++i) {
+      wrong += PerBlobCorners(filled[i], i, harris) != 4 ||
+               detector_.blobs_.vertexCount[i] != 4;
+    }
+    const int outside = CornersOutside();
+    mismatches_ += wrong + outside;
+    cout << "{\"check\":\"" << name << "\",\"params\":{"
+         << Param("blob_size", size) << ",\"layout\":\""
+         << (nested ? "nested" : "side") << "\"},\"blobs\":" << filled.size()
+         << ",\"wrong_corner_counts\":" << wrong
+         << ",\"corners_outside\":" << outside << "}" << endl;
+  }
+
+  // Per-blob stages on a single glyph-shaped blob of size x size pixels.
+  void Blob(const int size)
+  {
+    const int cell = size / 7;
+    Mat scene(size + 2 * cell, size + 2 * cell, CV_8UC1, Scalar(230));
+    srand(1);
+    DrawGlyph(&scene, cell, cell, cell);
+
+    // The dark pixels are the blobs; the glyph is the largest one.
+    detector_.blobs_.Clear();
+    detector_.Label(scene > 128, 0, scene.cols + 1);
+    const BlobTable& blobs = detector_.blobs_;
+    int blob = 0;
+    for (size_t i = 0; i < blobs.Size(); ++i) {
+      if (blobs.numPixels[i] > blobs.numPixels[blob]) {
+        blob = i;
+      }
+    }
+    const Point2f origin = blobs.origin[blob];
+    const Rect bbox = blobs.bbox[blob];
+
+    const string params = Param("blob_size", size);
+
+    short label = blobs.label[blob];
+    short other = label + 1000;
+    BlobShape shape;
+    Measure("FloodFill", params, [&]() {
+      detector_.FloodFill(origin, label, other, numeric_limits<int>::max(),
+                          &shape);
+      swap(label, other);
+    });
+    if (label != blobs.label[blob]) {
+      detector_.FloodFill(origin, label, other, numeric_limits<int>::max(),
+                          &shape);
+    }
+
+    Bitmap filled;
+    Measure("FillHoles", params, [&]() {
+      detector_.FillHoles(blob, &filled);
+    });
+
+    const BlobDetector::CornerHarrisParams harris = HarrisParams();
+
+    Measure("DetectVertices", params, [&]() {
+      vector<Point2f> vertices;
+      detector_.DetectVertices(filled, harris, bbox, &vertices);
+    });
+
+    // Corners of the glyph, slightly off so snapping has work to do.
+    vector<Point2f> corners;
+    corners.push_back(Point2f(cell + 3, cell + 3));
+    corners.push_back(Point2f(cell + size - 3, cell + 3));
+    corners.push_back(Point2f(cell + size - 3, cell + size - 3));
+    corners.push_back(Point2f(cell + 3, cell + size - 3));
+
+    const int windowSize =
+        Configuration::Instance().ReadInt("snap_vertices_window_size");
+    const float searchFactor =
+        Configuration::Instance().ReadFloat("snap_vertices_search_factor");
+    Measure("SnapVerticesToEdgesOfConvexPolygon", params, [&]() {
+      vector<Point2f> vertices = corners;
+      detector_.SnapVerticesToEdgesOfConvexPolygon(filled, bbox, searchFactor,
+                                                   windowSize, vertices.data(),
+                                                   vertices.size());
+    });
+  }
+
+  // Validator stages on a glyph of size x size pixels.
+  void Cells(const int size)
+  {
+    const int cell = size / 7;
+    Mat scene(size + 2 * cell, size + 2 * cell, CV_8UC1, Scalar(230));
+    srand(1);
+    DrawGlyph(&scene, cell, cell, cell);
+
+    vector<Point2f> corners;
+    corners.push_back(Point2f(cell + size, cell));
+    corners.push_back(Point2f(cell + size, cell + size));
+    corners.push_back(Point2f(cell, cell));
+    corners.push_back(Point2f(cell, cell + size));
+
+    const string params = Param("blob_size", size);
+
+    Measure("ReorderPoints", params, [&]() {
+      validator_.ReorderPoints(corners);
+    });
+
+    Point2f modelPts[] = {
+      Point2f(0, 0), Point2f(1, 0), Point2f(1, 1), Point2f(0, 1)
+    };
+    const vector<Point2f> reordered = validator_.ReorderPoints(corners);
+    Point2f imagePts[] = { reordered[0], reordered[1], reordered[2], reordered[3] };
+    const Mat H = getPerspectiveTransform(modelPts, imagePts);
+
+    // Every specialized sampler reads the same quad. The drawn glyph has a
+    // 5x5 payload, the other sizes give up at their first mixed cell.
+    for (int grid = 3; grid <= 7; ++grid) {
+      Measure("SampleCells", params + "," + Param("grid_size", grid), [&]() {
+        uint64_t code = 0;
+        GlyphValidator::SampleCells(grid, scene, H.ptr<double>(), nullptr,
+                                    &code, nullptr);
+      });
+    }
+  }
+
+  void Reduce(const int count)
+  {
+    srand(1);
+    vector<Point2f> vertices;
+    for (int i = 0; i < count; ++i) {
+      vertices.push_back(Point2f(rand() % 100, rand() % 100));
+    }
+
+    const float mergingDistance =
+        Configuration::Instance().ReadFloat("vertices_merging_distance");
+    Measure("ReduceVertices", Param("vertices", count), [&]() {
+      vector<Point2f> reduced;
+      detector_.ReduceVertices(vertices, &reduced, mergingDistance);
+    });
+  }
+
+  const string filter_;
+  BlobDetector detector_;
+  GlyphValidator validator_;
+  long mismatches_;
+};
+
+int main(int argc, char** argv)
+{
+  Configuration::Instance().LoadOnce("configuration.txt");
+
+  StageBenchmark benchmark(argc > 1 ? argv[1] : "");
+  benchmark.Run();
+
+  return benchmark.Mismatches() > 0 ? 1 : 0;
+}
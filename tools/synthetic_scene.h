@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdlib>
+
+#include "opencv2/opencv.hpp"
+
+// Synthetic camera frames shared by the benchmarks: white paper lit from the
+// left with black-bordered 5x5 glyphs of random cells on it.
+
+// Brightness of white paper at column x.
+inline int Lighting(const int x, const int width)
+{
+  return 230 - 140 * x / width;
+}
+
+// Draws a glyph with cells of cell pixels and its top-left corner at (ox, oy).
+inline void DrawGlyph(cv::Mat* scene, const int ox, const int oy,
+                      const int cell)
+{
+  cv::rectangle(*scene, cv::Rect(ox, oy, 7 * cell, 7 * cell), cv::Scalar(20),
+                -1);
+  for (int r = 0; r < 5; ++r) {
+    for (int c = 0; c < 5; ++c) {
+      if (rand() % 2) {
+        const int x = ox + (c + 1) * cell;
+        cv::rectangle(*scene, cv::Rect(x, oy + (r + 1) * cell, cell, cell),
+                      cv::Scalar(Lighting(x, scene->cols)), -1);
+      }
+    }
+  }
+}
+
+// A frame with the given number of glyphs at random places. The same
+// arguments always give the same frame.
+inline cv::Mat SyntheticScene(const int width, const int height,
+                              const int glyphs)
+{
+  cv::Mat scene(height, width, CV_8UC1);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      scene.at<uchar>(y, x) = Lighting(x, width);
+    }
+  }
+
+  srand(1);
+  const int cell = height / 28;
+  for (int i = 0; i < glyphs; ++i) {
+    DrawGlyph(&scene, cell + rand() % (width - 9 * cell),
+              cell + rand() % (height - 9 * cell), cell);
+  }
+
+  return scene;
+}